@@ -0,0 +1,67 @@
+#include "la-cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Replays a simulator-like execution trace (a few thousand hot instruction words
+// executed over and over) through disassemble_to() with and without a
+// DisassemblyCache, and reports the cache hit rate.
+
+using LADisassembler::Disassembler;
+using LADisassembler::DisassemblyCache;
+
+int main() {
+    Disassembler d;
+    d.set_imm_hex(true);
+    d.set_reg_prefix(true);
+
+    // A 4096-instruction "program" at 0x80000000, executed in loops of random length.
+    std::mt19937 rng(3);
+    std::vector<uint32_t> program;
+    Disassembler::DecodeTokenArray t;
+    while (program.size() < 4096) {
+        uint32_t inst = rng() & ((rng() & 1) ? 0xffffffff : 0x003fffff);
+        if (d.disassemble_to_tokens(inst, t)) {
+            program.push_back(inst);
+        }
+    }
+    std::vector<uint32_t> trace;
+    while (trace.size() < (1 << 22)) {
+        std::size_t start = rng() % program.size();
+        std::size_t length = 16 + rng() % 256;
+        for (std::size_t i = start; i < std::min(program.size(), start + length); i++) {
+            trace.push_back(i);
+        }
+    }
+
+    char a[128], b[128];
+    uint64_t sink = 0;
+    auto time = [&](auto &&f) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t index : trace) {
+            sink += f(program[index], 0x80000000 + 4 * (uint64_t)index);
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / trace.size();
+    };
+
+    DisassemblyCache cache(d);
+    double plain = time([&](uint32_t inst, uint64_t pc) { return d.disassemble_to(a, sizeof(a), inst, pc); });
+    double cached = time([&](uint32_t inst, uint64_t pc) { return cache.disassemble_to(b, sizeof(b), inst, pc); });
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < 100000; i++) {
+        uint32_t index = trace[i];
+        d.disassemble_to(a, sizeof(a), program[index], 0x80000000 + 4 * (uint64_t)index);
+        cache.disassemble_to(b, sizeof(b), program[index], 0x80000000 + 4 * (uint64_t)index);
+        mismatches += std::strcmp(a, b) != 0;
+    }
+
+    DisassemblyCache::Stats s = cache.stats();
+    std::printf("disassemble_to:             %6.2f ns/inst\n", plain);
+    std::printf("DisassemblyCache (%5zu):   %6.2f ns/inst\n", cache.capacity(), cached);
+    std::printf("hits %llu, misses %llu, hit rate %.2f%%, mismatches %zu\n",
+        (unsigned long long)s.hits, (unsigned long long)s.misses, 100.0 * s.hits / (s.hits + s.misses), mismatches);
+    std::printf("(checksum %llu)\n", (unsigned long long)sink);
+    return mismatches != 0;
+}
@@ -0,0 +1,74 @@
+#include "la-disassembler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Compares batch classification of a large image (Decoder::decode_batch, which
+// uses the AVX2 tree walk when available) against the scalar Decoder::decode
+// path over the instruction table, and the batched token API against
+// per-word disassemble_to_tokens.
+
+using LADisassembler::Disassembler;
+
+template<typename F>
+static double ns_per_inst(std::size_t n, int rounds, F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)n * rounds);
+}
+
+int main() {
+    Disassembler d;
+    const std::size_t n = 1 << 22;
+
+    // Mostly valid code with a sprinkling of data words, like a real text section.
+    std::mt19937 rng(7);
+    std::vector<uint32_t> image;
+    Disassembler::DecodeTokenArray t;
+    while (image.size() < n) {
+        uint32_t inst = rng();
+        if (rng() & 1) {
+            inst &= 0x003fffff;
+        }
+        if (d.disassemble_to_tokens(inst, t) || rng() % 16 == 0) {
+            image.push_back(inst);
+        }
+    }
+
+    const auto &decoder = Disassembler::decoder();
+
+    std::vector<int32_t> scalar(n), batch(n);
+    uint64_t sink = 0;
+
+    double tScalar = ns_per_inst(n, 10, [&] {
+        for (std::size_t i = 0; i < n; i++) {
+            scalar[i] = decoder.decode_index(image[i]);
+        }
+    });
+    double tBatch = ns_per_inst(n, 10, [&] {
+        decoder.decode_batch(image.data(), n, batch.data());
+    });
+    bool same = scalar == batch;
+
+    std::vector<Disassembler::DecodeTokenArray> tokens(n);
+    double tTokens = ns_per_inst(n, 5, [&] {
+        for (std::size_t i = 0; i < n; i++) {
+            tokens[i] = Disassembler::DecodeTokenArray();
+            sink += d.disassemble_to_tokens(image[i], tokens[i]);
+        }
+    });
+    double tTokensBatch = ns_per_inst(n, 5, [&] {
+        sink += d.disassemble_to_tokens(image.data(), n, tokens.data());
+    });
+
+    std::printf("Decoder::decode (scalar):     %6.2f ns/inst\n", tScalar);
+    std::printf("Decoder::decode_batch:        %6.2f ns/inst (%s)\n", tBatch, same ? "results match" : "RESULTS DIFFER");
+    std::printf("disassemble_to_tokens (word): %6.2f ns/inst\n", tTokens);
+    std::printf("disassemble_to_tokens (batch):%6.2f ns/inst\n", tTokensBatch);
+    std::printf("(checksum %llu)\n", (unsigned long long)sink);
+    return same ? 0 : 1;
+}
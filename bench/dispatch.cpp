@@ -0,0 +1,74 @@
+#include "la-disassembler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Measures the per-instruction cost of decode + dispatch (disassemble_to_tokens)
+// and of the full text paths (disassemble, disassemble_to, disassemble_block)
+// over a corpus of valid instructions.
+
+static std::vector<uint32_t> make_corpus(const LADisassembler::Disassembler &d, std::size_t n) {
+    std::mt19937 rng(42);
+    std::vector<uint32_t> corpus;
+    LADisassembler::Disassembler::DecodeTokenArray tokens;
+    while (corpus.size() < n) {
+        uint32_t inst = rng();
+        if (rng() & 1) {
+            inst &= 0x003fffff; // the densely populated 3R / 2RI12 / shift region
+        }
+        if (d.disassemble_to_tokens(inst, tokens)) {
+            corpus.push_back(inst);
+        }
+    }
+    return corpus;
+}
+
+template<typename F>
+static double ns_per_inst(const std::vector<uint32_t> &corpus, int rounds, F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t inst : corpus) {
+            f(inst);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)corpus.size() * rounds);
+}
+
+int main() {
+    LADisassembler::Disassembler d;
+    d.set_imm_hex(true);
+    d.set_reg_prefix(true);
+
+    std::vector<uint32_t> corpus = make_corpus(d, 1 << 16);
+
+    uint64_t sink = 0;
+    LADisassembler::Disassembler::DecodeTokenArray tokens;
+    double tok = ns_per_inst(corpus, 200, [&](uint32_t inst) {
+        d.disassemble_to_tokens(inst, tokens);
+        sink += tokens.tokens[1].num;
+    });
+    double text = ns_per_inst(corpus, 20, [&](uint32_t inst) {
+        sink += d.disassemble(inst, 0x80000000).size();
+    });
+    char buf[128];
+    double to = ns_per_inst(corpus, 50, [&](uint32_t inst) {
+        sink += d.disassemble_to(buf, sizeof(buf), inst, 0x80000000);
+    });
+    std::string out;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < 50; r++) {
+        out.clear();
+        d.disassemble_block(corpus.data(), corpus.size(), 0x80000000, out);
+        sink += out.size();
+    }
+    double block = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (corpus.size() * 50.0);
+
+    std::printf("disassemble_to_tokens: %6.2f ns/inst\n", tok);
+    std::printf("disassemble:           %6.2f ns/inst\n", text);
+    std::printf("disassemble_to:        %6.2f ns/inst\n", to);
+    std::printf("disassemble_block:     %6.2f ns/inst\n", block);
+    std::printf("(checksum %llu)\n", (unsigned long long)sink);
+    return 0;
+}
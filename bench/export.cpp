@@ -0,0 +1,76 @@
+#include "la-corpus.h"
+#include "la-export.h"
+
+#include <chrono>
+#include <cstdio>
+
+// Exports a 16 MB image of weighted synthetic code as a token stream and as a
+// text listing, then reads the stream back in place through TokenStreamReader.
+// Text formatted from the records is checked against disassemble_to().
+
+using LADisassembler::CorpusGenerator;
+using LADisassembler::Disassembler;
+using LADisassembler::TokenRecord;
+using LADisassembler::TokenStreamReader;
+using LADisassembler::TokenStreamWriter;
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    // By default the stream goes next to the binary, wherever it is run from.
+    std::string path = argc > 1 ? argv[1] : std::string(argv[0]);
+    if (argc <= 1) {
+        std::size_t slash = path.rfind('/');
+        path = (slash == std::string::npos ? std::string(".") : path.substr(0, slash)) + "/export.tokens";
+    }
+    Disassembler d;
+    d.set_imm_hex(true);
+
+    const std::size_t n = (16 << 20) / 4;
+    const uint64_t base = 0x120000000ULL;
+    CorpusGenerator generator(11);
+    std::vector<uint32_t> image = generator.generate(CorpusGenerator::WEIGHTED, n);
+
+    TokenStreamWriter writer(d);
+    auto start = std::chrono::steady_clock::now();
+    if (!writer.open(path.c_str()) || !writer.write(image.data(), n, base) || !writer.close()) {
+        return 1;
+    }
+    double written = ms_since(start);
+    std::printf("write tokens:  %8.3f ms, %6.2f ns/inst, %.1f MB\n", written, written * 1e6 / n, (n * sizeof(TokenRecord)) / 1e6);
+
+    std::size_t bytes = 0;
+    auto count = [&](uint64_t, uint32_t, const char *, std::size_t length) { bytes += length + 1; };
+    start = std::chrono::steady_clock::now();
+    d.disassemble_block(image.data(), n, base, count);
+    double text = ms_since(start);
+    std::printf("format text:   %8.3f ms, %6.2f ns/inst, %.1f MB\n", text, text * 1e6 / n, bytes / 1e6);
+
+    TokenStreamReader reader;
+    start = std::chrono::steady_clock::now();
+    if (!reader.open(path.c_str())) {
+        return 1;
+    }
+    uint64_t sum = 0;
+    for (const TokenRecord &r : reader) {
+        sum += r.opcode + r.operands[0];
+    }
+    double scanned = ms_since(start);
+    std::printf("map and scan:  %8.3f ms, %6.2f ns/inst (checksum %llx)\n", scanned, scanned * 1e6 / n, (unsigned long long)sum);
+
+    std::size_t mismatches = reader.count() != n;
+    Disassembler::DecodeTokenArray tokens;
+    for (std::size_t i = 0; i < n && i < reader.count(); i++) {
+        const TokenRecord &r = reader[i];
+        char text[128], expected[128];
+        std::size_t length = reader.tokens(r, tokens) ? d.fmt_tokens_to(text, sizeof(text), r.pc, tokens) : 0;
+        std::size_t expectedLength = d.disassemble_to(expected, sizeof(expected), image[i], base + 4 * (uint64_t)i);
+        mismatches += r.word != image[i] || length != expectedLength || std::memcmp(text, expected, length) != 0;
+    }
+    std::printf("mismatches: %zu (%u strings)\n", mismatches, reader.string_count());
+    reader.close();
+    std::remove(path.c_str());
+    return mismatches != 0;
+}
@@ -0,0 +1,74 @@
+#include "la-corpus.h"
+#include "la-incremental.h"
+
+#include <chrono>
+#include <cstdio>
+
+// Patches a few words of a 16 MB image, as a debugger or JIT would, and compares
+// re-dumping the whole listing with IncrementalListing::update() (snapshot
+// hashing) and mark_dirty() + update_dirty(). The refreshed listing is checked
+// against a full re-disassembly.
+
+using LADisassembler::CorpusGenerator;
+using LADisassembler::Disassembler;
+using LADisassembler::IncrementalListing;
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    Disassembler d;
+    d.set_imm_hex(true);
+    d.set_reg_prefix(true);
+
+    const std::size_t n = (16 << 20) / 4;
+    const uint64_t base = 0x120000000ULL;
+    CorpusGenerator generator(9);
+    std::vector<uint32_t> image = generator.generate(CorpusGenerator::WEIGHTED, n);
+
+    IncrementalListing::Options options;
+    options.addresses = true;
+    IncrementalListing listing(d, options);
+    auto start = std::chrono::steady_clock::now();
+    listing.load(image.data(), n, base);
+    std::printf("load:          %8.3f ms (%zu pages)\n", ms_since(start), listing.page_count());
+
+    std::string full;
+    start = std::chrono::steady_clock::now();
+    d.disassemble_block(image.data(), n, base, full);
+    std::printf("full re-dump:  %8.3f ms\n", ms_since(start));
+
+    // Each round patches 8 words scattered over the image.
+    const int ROUNDS = 20;
+    double snapshot = 0, dirty = 0;
+    std::size_t pages = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < 8; i++) {
+            std::size_t at = generator.next(CorpusGenerator::NOISE) % n;
+            image[at] = generator.next(CorpusGenerator::UNIFORM);
+            if (round & 1) {
+                listing.mark_dirty(base + 4 * at, 4);
+            }
+        }
+        start = std::chrono::steady_clock::now();
+        pages += (round & 1) ? listing.update_dirty(image.data()) : listing.update(image.data());
+        ((round & 1) ? dirty : snapshot) += ms_since(start);
+    }
+    std::printf("update:        %8.3f ms per edit (snapshot hashing)\n", snapshot / (ROUNDS / 2));
+    std::printf("update_dirty:  %8.3f ms per edit (dirty ranges)\n", dirty / (ROUNDS / 2));
+    std::printf("pages re-formatted per edit: %.1f\n", (double)pages / ROUNDS);
+
+    std::string refreshed;
+    listing.write([&](const char *text, std::size_t length) { refreshed.append(text, length); });
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        char text[128];
+        std::size_t length;
+        const char *line = listing.line(i, length);
+        std::size_t expected = d.disassemble_to(text, sizeof(text), image[i], base + 4 * (uint64_t)i);
+        mismatches += expected > length || std::memcmp(line + length - expected, text, expected) != 0;
+    }
+    std::printf("mismatches: %zu (%.1f MB listing)\n", mismatches, refreshed.size() / 1e6);
+    return mismatches != 0;
+}
@@ -0,0 +1,51 @@
+#include "la-parallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Thread-scaling benchmark for ParallelDisassembler: disassembles the same image
+// with 1, 2, 4, ... workers up to the hardware thread count and reports the
+// throughput and speedup over one thread.
+
+using LADisassembler::Disassembler;
+using LADisassembler::ParallelDisassembler;
+
+int main() {
+    Disassembler d;
+    d.set_imm_hex(true);
+    d.set_reg_prefix(true);
+
+    const std::size_t n = 1 << 22;
+    std::mt19937 rng(11);
+    std::vector<uint32_t> image(n);
+    for (uint32_t &w : image) {
+        w = rng();
+        if (rng() & 1) {
+            w &= 0x003fffff;
+        }
+    }
+
+    unsigned int hardware = std::max(1U, std::thread::hardware_concurrency());
+    double base = 0;
+    for (unsigned int threads = 1; threads <= std::max(2U, hardware); threads *= 2) {
+        ParallelDisassembler::Options options;
+        options.threads = threads;
+        options.addresses = true;
+        ParallelDisassembler p(d, options);
+
+        std::size_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        p.run(image.data(), n, 0x80000000, [&](const char *, std::size_t length) { bytes += length; });
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) {
+            base = ns;
+        }
+        std::printf("threads %2u: %6.2f ns/inst, %7.1f MB/s text, speedup %.2fx\n",
+            threads, ns / n, bytes / ns * 1e3, base / ns);
+    }
+    if (hardware == 1) {
+        std::printf("(only one hardware thread available; scaling is not measurable here)\n");
+    }
+    return 0;
+}
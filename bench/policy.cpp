@@ -0,0 +1,62 @@
+#include "la-disassembler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Formats pre-decoded tokens with the generic formatter, which checks every option
+// per operand, and with the FormatPolicy specialization for the same options, for
+// each of the 16 policies. Both must produce identical text.
+
+using LADisassembler::Disassembler;
+using LADisassembler::FormatOptions;
+
+int main() {
+    Disassembler d;
+    std::mt19937 rng(2);
+    std::vector<Disassembler::DecodeTokenArray> tokens;
+    Disassembler::DecodeTokenArray t;
+    while (tokens.size() < (1 << 20)) {
+        uint32_t inst = rng() & ((rng() & 1) ? 0xffffffff : 0x003fffff);
+        if (d.disassemble_to_tokens(inst, t)) {
+            tokens.push_back(t);
+        }
+    }
+
+    char a[128], b[128];
+    uint64_t sink = 0;
+    std::size_t mismatches = 0;
+    auto time = [&](Disassembler::TokenFormatter format, const FormatOptions &opt) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t pc = 0x9000000000000000;
+        for (const Disassembler::DecodeTokenArray &t : tokens) {
+            sink += format(a, sizeof(a), pc, t, opt);
+            pc += 4;
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / tokens.size();
+    };
+
+    std::printf("policy  hex alias prefix la32   generic  specialized  (ns/inst)\n");
+    for (unsigned int policy = 0; policy < 16; policy++) {
+        FormatOptions opt;
+        opt.hexImm = policy & 1;
+        opt.regAlias = policy & 2;
+        opt.regPrefix = policy & 4;
+        opt.mode32 = policy & 8;
+        Disassembler::TokenFormatter generic = Disassembler::token_formatter(opt, false);
+        Disassembler::TokenFormatter specialized = Disassembler::token_formatter(opt);
+
+        for (std::size_t i = 0; i < tokens.size(); i += 97) {
+            generic(a, sizeof(a), 0x80000000 + 4 * i, tokens[i], opt);
+            specialized(b, sizeof(b), 0x80000000 + 4 * i, tokens[i], opt);
+            mismatches += std::strcmp(a, b) != 0;
+        }
+
+        double g = time(generic, opt);
+        double s = time(specialized, opt);
+        std::printf("%6u  %3d %5d %6d %4d   %7.2f  %11.2f  %+6.1f%%\n",
+            policy, opt.hexImm, opt.regAlias, opt.regPrefix, opt.mode32, g, s, 100.0 * (s - g) / g);
+    }
+    std::printf("mismatches %zu\n(checksum %llu)\n", mismatches, (unsigned long long)sink);
+    return mismatches != 0;
+}
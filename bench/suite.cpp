@@ -0,0 +1,177 @@
+#include "la-cache.h"
+#include "la-corpus.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Benchmark suite for tracking regressions. For each decode table (LA64, LA32)
+// and each CorpusGenerator corpus (uniform, weighted, noise) it times the decode
+// tree alone (Decoder::decode), decode plus token expansion
+// (disassemble_to_tokens), and the text paths (disassemble, disassemble_to,
+// disassemble_block, and DisassemblyCache over a looping trace).
+//
+// Output is JSON Lines on stdout: first one "table" record per decode table
+// (pattern count, bytes a lookup may touch, tree depth), then one "result" record
+// per table, corpus and path with ns_per_inst (best of several runs),
+// allocs_per_inst (operator new calls), valid_ratio and, for the cache path,
+// hits, misses and hit_rate.
+
+using LADisassembler::CorpusGenerator;
+using LADisassembler::Disassembler;
+using LADisassembler::DisassemblyCache;
+using LADisassembler::FormatOptions;
+
+static std::size_t allocations = 0;
+
+// Not inlined, so that GCC does not pair the malloc/free inside with the new and
+// delete at call sites and warn about a mismatch.
+__attribute__((noinline)) void *operator new(std::size_t size) {
+    allocations++;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+static const std::size_t CORPUS_SIZE = 1 << 16;
+static const std::size_t TRACE_SIZE = 1 << 20;
+static const int RUNS = 5;
+
+struct Measurement {
+    double nsPerInst;
+    double allocsPerInst;
+};
+
+// Runs f (which handles n instructions) several times; reports the fastest run.
+template<typename F>
+static Measurement measure(std::size_t n, F &&f) {
+    Measurement m{1e30, 0};
+    for (int run = 0; run < RUNS; run++) {
+        std::size_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        f();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        m.nsPerInst = std::min(m.nsPerInst, ns / n);
+        m.allocsPerInst = (double)(allocations - before) / n;
+    }
+    return m;
+}
+
+static void report(const char *table, const char *corpus, const char *path, double validRatio, const Measurement &m,
+        const DisassemblyCache::Stats *cache = nullptr) {
+    std::printf("{\"record\":\"result\",\"table\":\"%s\",\"corpus\":\"%s\",\"path\":\"%s\","
+        "\"ns_per_inst\":%.3f,\"allocs_per_inst\":%.4f,\"valid_ratio\":%.4f",
+        table, corpus, path, m.nsPerInst, m.allocsPerInst, validRatio);
+    if (cache) {
+        std::printf(",\"hits\":%llu,\"misses\":%llu,\"hit_rate\":%.4f",
+            (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+            (double)cache->hits / (cache->hits + cache->misses));
+    }
+    std::printf("}\n");
+}
+
+int main() {
+    uint64_t sink = 0;
+    for (bool mode32 : {false, true}) {
+        const char *table = mode32 ? "la32" : "la64";
+        const auto &decoder = Disassembler::decoder(mode32);
+        std::printf("{\"record\":\"table\",\"table\":\"%s\",\"patterns\":%u,\"table_bytes\":%zu,\"depth\":%u}\n",
+            table, decoder.count(), decoder.table_bytes(), decoder.tree_depth());
+    }
+
+    for (bool mode32 : {false, true}) {
+        const char *table = mode32 ? "la32" : "la64";
+        const auto &decoder = Disassembler::decoder(mode32);
+        FormatOptions opt;
+        opt.hexImm = true;
+        opt.regPrefix = true;
+        opt.mode32 = mode32;
+        Disassembler d;
+        d.set_options(opt);
+
+        for (CorpusGenerator::Kind kind : {CorpusGenerator::UNIFORM, CorpusGenerator::WEIGHTED, CorpusGenerator::NOISE}) {
+            const char *corpus = CorpusGenerator::name(kind);
+            CorpusGenerator generator(1, mode32);
+            std::vector<uint32_t> words = generator.generate(kind, CORPUS_SIZE);
+            std::size_t valid = 0;
+            for (uint32_t w : words) {
+                valid += decoder.decode_index(w) >= 0;
+            }
+            double validRatio = (double)valid / words.size();
+            const std::size_t n = words.size();
+
+            report(table, corpus, "decode", validRatio, measure(n, [&] {
+                std::decay_t<decltype(decoder.entry(0))> e = nullptr;
+                for (uint32_t w : words) {
+                    sink += decoder.decode(w, e);
+                }
+            }));
+
+            report(table, corpus, "disassemble_to_tokens", validRatio, measure(n, [&] {
+                Disassembler::DecodeTokenArray tokens;
+                for (uint32_t w : words) {
+                    sink += d.disassemble_to_tokens(w, tokens, opt);
+                }
+            }));
+
+            report(table, corpus, "disassemble", validRatio, measure(n, [&] {
+                uint64_t pc = 0x80000000;
+                for (uint32_t w : words) {
+                    sink += d.disassemble(w, pc, opt).size();
+                    pc += 4;
+                }
+            }));
+
+            report(table, corpus, "disassemble_to", validRatio, measure(n, [&] {
+                char text[128];
+                uint64_t pc = 0x80000000;
+                for (uint32_t w : words) {
+                    sink += d.disassemble_to(text, sizeof(text), w, pc, opt);
+                    pc += 4;
+                }
+            }));
+
+            std::string listing;
+            listing.reserve(n * 48);
+            report(table, corpus, "disassemble_block", validRatio, measure(n, [&] {
+                listing.clear();
+                d.disassemble_block(words.data(), n, 0x80000000, listing, opt);
+                sink += listing.size();
+            }));
+
+            // A simulator-like trace: runs of 16-271 consecutive words from a
+            // 4096-word program, so the same words repeat.
+            std::mt19937 rng(3);
+            std::vector<uint32_t> trace;
+            trace.reserve(TRACE_SIZE + 272);
+            while (trace.size() < TRACE_SIZE) {
+                std::size_t start = rng() % 4096;
+                std::size_t length = 16 + rng() % 256;
+                for (std::size_t i = start; i < std::min<std::size_t>(4096, start + length); i++) {
+                    trace.push_back(i);
+                }
+            }
+            DisassemblyCache cache(d);
+            Measurement m = measure(trace.size(), [&] {
+                char text[128];
+                for (uint32_t index : trace) {
+                    sink += cache.disassemble_to(text, sizeof(text), words[index], 0x80000000 + 4 * (uint64_t)index);
+                }
+            });
+            DisassemblyCache::Stats stats = cache.stats();
+            report(table, corpus, "cache_disassemble_to", validRatio, m, &stats);
+        }
+    }
+    std::fprintf(stderr, "(checksum %llu)\n", (unsigned long long)sink);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "la-trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+// Compares the execution-path cost of keeping an instruction trace by formatting
+// every instruction with disassemble() against recording raw words into an
+// InstructionTrace, then measures deferred formatting by a concurrent consumer.
+
+using LADisassembler::Disassembler;
+using LADisassembler::InstructionTrace;
+
+int main() {
+    Disassembler d;
+    std::mt19937 rng(5);
+    std::vector<uint32_t> program(1 << 16);
+    for (uint32_t &inst : program) {
+        inst = rng() & ((rng() & 1) ? 0xffffffff : 0x003fffff);
+    }
+    const std::size_t N = 1 << 23;
+
+    auto time = [&](auto &&f) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < N; i++) {
+            std::size_t index = i & (program.size() - 1);
+            f(0x80000000 + 4 * (uint64_t)index, program[index]);
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+    };
+
+    uint64_t sink = 0;
+    double eager = time([&](uint64_t pc, uint32_t inst) { sink += d.disassemble(inst, pc).size(); });
+
+    InstructionTrace trace;
+    double recorded = time([&](uint64_t pc, uint32_t inst) { trace.record(pc, inst); });
+
+    // Drain into text on another thread while the producer keeps recording.
+    InstructionTrace live;
+    std::atomic<bool> done{false};
+    std::size_t formatted = 0, torn = 0;
+    std::thread consumer([&] {
+        auto check = [&](uint64_t pc, uint32_t inst, const char *, std::size_t length) {
+            formatted++;
+            torn += program[(pc - 0x80000000) / 4] != inst;
+            sink += length;
+        };
+        while (!done.load(std::memory_order_acquire)) {
+            live.drain(d, check);
+        }
+        live.drain(d, check);
+    });
+    double concurrent = time([&](uint64_t pc, uint32_t inst) { live.record(pc, inst); });
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    std::printf("disassemble() per instruction:  %6.2f ns/inst\n", eager);
+    std::printf("InstructionTrace::record():     %6.2f ns/inst\n", recorded);
+    std::printf("record() with live consumer:    %6.2f ns/inst\n", concurrent);
+    std::printf("consumer formatted %zu, dropped %llu, torn %zu\n",
+        formatted, (unsigned long long)live.dropped(), torn);
+    std::printf("(checksum %llu)\n", (unsigned long long)sink);
+    return torn != 0 || formatted + live.dropped() != N;
+}
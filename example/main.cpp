@@ -1,4 +1,7 @@
 #include "la-disassembler.h"
+#include "la-elf.h"
+
+#include <cstdio>
 
 uint32_t input_inst() {
     std::string line;
@@ -11,11 +14,58 @@ uint32_t input_inst() {
     return inst;
 }
 
-int main() {
+int dump_elf(LADisassembler::Disassembler &disassembler, const char *path) {
+    LADisassembler::ElfImage image;
+    if (!image.open(path)) {
+        return 1;
+    }
+    disassembler.set_mode32(!image.elf64());
+    disassembler.set_symbol_resolver(&image.symbols());
+
+    std::string out;
+    auto line = [&](uint64_t pc, uint32_t inst, const char *text, std::size_t length) {
+        const LADisassembler::SymbolTable::Symbol *sym = image.symbols().lookup(pc);
+        if (sym && sym->addr == pc) {
+            out += "\n<";
+            out += sym->name;
+            out += ">:\n";
+        }
+        char head[40];
+        LADisassembler::TextWriter w(head, sizeof(head));
+        w.put_hex(pc, 8);
+        w.put(":  ");
+        w.put_hex(inst, 8);
+        w.put("  ");
+        out.append(head, w.finish());
+        out.append(text, length);
+        out.push_back('\n');
+        if (out.size() >= (1 << 16)) {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    };
+    for (const LADisassembler::ElfImage::Section &section : image.sections()) {
+        out += "\nDisassembly of section ";
+        out += section.name;
+        out += ":\n";
+        disassembler.disassemble_block(section.words, section.count, section.addr, line);
+    }
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
+
+int main(int argc, char **argv) {
     LADisassembler::Disassembler disassembler;
     disassembler.set_imm_hex(true);
     disassembler.set_reg_alias(false);
     disassembler.set_reg_prefix(true);
+    if (argc > 1) {
+        int status = dump_elf(disassembler, argv[1]);
+        if (LADisassembler::Disassembler::stats_enabled()) {
+            LADisassembler::Disassembler::dump_stats(std::cerr, LADisassembler::Disassembler::stats());
+        }
+        return status;
+    }
     while (true) {
         uint32_t inst = input_inst();
         if (inst == 0) {
@@ -0,0 +1,199 @@
+#ifndef __LADISASSEMBLER_CACHE_H__
+#define __LADISASSEMBLER_CACHE_H__
+
+#include "la-disassembler.h"
+
+namespace LADisassembler {
+
+// Memoizes decode and formatting for traces that repeat the same instruction
+// words. Entries are keyed on the word and the key() of the options used (the
+// disassembler's own unless a call passes FormatOptions); they hold the decoded
+// tokens and the text with the PC-relative operand cut out, which is
+// re-formatted for the actual PC on every hit.
+//
+// The cache is bounded (four-way set associative, LRU within a set) and not
+// thread-safe: use one per thread. The disassembler must outlive it.
+class DisassemblyCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+private:
+    static constexpr std::size_t TEXT_MAX = 64;
+    static constexpr uint8_t NO_PC = 0xff;
+    static constexpr unsigned int WAYS = 4;
+    static constexpr uint64_t TAG_FILLED = 1ULL << 63;
+
+    struct Entry {
+        bool valid = false;
+        bool cachedText = false;
+        uint8_t length = 0;   // text length without the PC-relative operand
+        uint8_t pcAt = NO_PC; // where the PC-relative operand goes
+        uint64_t pcOff = 0;
+        Disassembler::DecodeTokenArray tokens;
+        char text[TEXT_MAX];
+    };
+
+    const Disassembler &disassembler;
+    // Tags (word, options key, filled bit) are kept apart from the entries so that
+    // probing a set touches a single cache line.
+    std::vector<uint64_t> tags;
+    std::vector<uint32_t> lastUse;
+    std::vector<Entry> entries;
+    uint32_t clock = 0;
+    unsigned int setBits;
+    Stats counters;
+
+    std::size_t set_of(uint32_t inst) const {
+        return (uint32_t)(inst * 0x9e3779b1U) >> (32 - setBits);
+    }
+
+    void fill(Entry &e, uint32_t inst, const FormatOptions &opt) {
+        e = Entry();
+        e.valid = Disassembler::decode(inst, e.tokens, opt);
+        if (!e.valid) {
+            e.cachedText = true;
+            return;
+        }
+
+        char text[128];
+        TextWriter w(text, sizeof(text));
+        std::pair<std::size_t, std::size_t> pcSpan(0, 0);
+        bool hasPc = false;
+        for (const Disassembler::DecodeToken &t : e.tokens.tokens) {
+            if (t.type == Disassembler::PCOFF) {
+                hasPc = true;
+                e.pcOff = t.num;
+            }
+        }
+        Disassembler::write_tokens(w, 0, e.tokens, opt, &pcSpan);
+        std::size_t length = w.finish();
+        std::size_t pcLength = hasPc ? pcSpan.second - pcSpan.first : 0;
+        if (length >= sizeof(text) || length - pcLength > TEXT_MAX) {
+            return;
+        }
+        if (hasPc) {
+            std::memcpy(e.text, text, pcSpan.first);
+            std::memcpy(e.text + pcSpan.first, text + pcSpan.second, length - pcSpan.second);
+            e.pcAt = pcSpan.first;
+        } else {
+            std::memcpy(e.text, text, length);
+        }
+        e.length = length - pcLength;
+        e.cachedText = true;
+    }
+
+    const Entry &lookup(uint32_t inst, const FormatOptions &opt) {
+        uint64_t tag = TAG_FILLED | (uint64_t)opt.key() << 32 | inst;
+        std::size_t first = set_of(inst) * WAYS;
+        clock++;
+        for (std::size_t i = first; i < first + WAYS; i++) {
+            if (tags[i] == tag) {
+                counters.hits++;
+                lastUse[i] = clock;
+                return entries[i];
+            }
+        }
+        counters.misses++;
+        std::size_t victim = first;
+        for (std::size_t i = first; i < first + WAYS; i++) {
+            if (!(tags[i] & TAG_FILLED)) {
+                victim = i;
+                break;
+            }
+            if (clock - lastUse[i] > clock - lastUse[victim]) {
+                victim = i;
+            }
+        }
+        fill(entries[victim], inst, opt);
+        tags[victim] = tag;
+        lastUse[victim] = clock;
+        return entries[victim];
+    }
+
+    void put(TextWriter &w, const Entry &e, uint64_t pc, const FormatOptions &opt) const {
+        if (!e.valid) {
+            return;
+        }
+        if (!e.cachedText) {
+            Disassembler::write_tokens(w, pc, e.tokens, opt);
+            return;
+        }
+        if (e.pcAt == NO_PC) {
+            w.put(e.text, e.length);
+            return;
+        }
+        w.put(e.text, e.pcAt);
+        Disassembler::write_pc(w, pc, e.pcOff, opt);
+        w.put(e.text + e.pcAt, e.length - e.pcAt);
+    }
+
+public:
+    // capacity is the number of cached words, rounded up to a power of two (at least 8).
+    DisassemblyCache(const Disassembler &disassembler, std::size_t capacity = 1 << 14)
+        : disassembler(disassembler) {
+        setBits = 1;
+        while (setBits < 31 && ((std::size_t)WAYS << setBits) < capacity) {
+            setBits++;
+        }
+        tags.resize((std::size_t)WAYS << setBits);
+        lastUse.resize(tags.size());
+        entries.resize(tags.size());
+    }
+
+    std::size_t capacity() const {
+        return entries.size();
+    }
+
+    bool disassemble_to_tokens(uint32_t inst, Disassembler::DecodeTokenArray &tokens, const FormatOptions &opt) {
+        const Entry &e = lookup(inst, opt);
+        if (e.valid) {
+            tokens = e.tokens;
+        }
+        return e.valid;
+    }
+
+    bool disassemble_to_tokens(uint32_t inst, Disassembler::DecodeTokenArray &tokens) {
+        return disassemble_to_tokens(inst, tokens, disassembler.options());
+    }
+
+    // Same text as Disassembler::disassemble_to().
+    std::size_t disassemble_to(char *buf, std::size_t cap, uint32_t inst, uint64_t pc, const FormatOptions &opt) {
+        TextWriter w(buf, cap);
+        put(w, lookup(inst, opt), pc, opt);
+        return w.finish();
+    }
+
+    std::size_t disassemble_to(char *buf, std::size_t cap, uint32_t inst, uint64_t pc) {
+        return disassemble_to(buf, cap, inst, pc, disassembler.options());
+    }
+
+    // Same text as Disassembler::disassemble().
+    std::string disassemble(uint32_t inst, uint64_t pc, const FormatOptions &opt) {
+        const Entry &e = lookup(inst, opt);
+        return Disassembler::to_string([&](TextWriter &w) { put(w, e, pc, opt); });
+    }
+
+    std::string disassemble(uint32_t inst, uint64_t pc) {
+        return disassemble(inst, pc, disassembler.options());
+    }
+
+    Stats stats() const {
+        return counters;
+    }
+
+    void reset_stats() {
+        counters = Stats();
+    }
+
+    void clear() {
+        std::fill(tags.begin(), tags.end(), 0);
+        reset_stats();
+    }
+};
+
+}
+
+#endif
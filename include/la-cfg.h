@@ -0,0 +1,329 @@
+#ifndef __LADISASSEMBLER_CFG_H__
+#define __LADISASSEMBLER_CFG_H__
+
+#include "la-disassembler.h"
+
+#include <atomic>
+#include <thread>
+
+namespace LADisassembler {
+
+// Control flow recovered from a region of code in one decode pass.
+//
+// build() decodes the region on a pool of worker threads and collects the
+// resolved targets of every direct branch and call into a sorted, deduplicated
+// index. Basic blocks start at the region start, at every target inside the
+// region and after every control transfer; a block ends after a branch, jump,
+// call or return, before the next target, or at a word that does not decode
+// (data in a code section), which has no successors. Edges are kept per block
+// in address order: the taken branch or call first, then the fall-through.
+//
+// is_target() is a binary search over the index, so a listing can place labels
+// ("L_80001234:") in O(log n) per line; block_at() is constant time.
+class ControlFlowGraph {
+public:
+    struct Options {
+        unsigned int threads = 0;          // 0: one per hardware thread
+        std::size_t chunkWords = 1 << 16;  // words per work item
+    };
+
+    static constexpr uint32_t NO_BLOCK = ~0U;
+
+    enum class EdgeKind : uint8_t {
+        FALLTHROUGH,
+        BRANCH,  // taken side of a conditional branch, or a jump
+        CALL,
+    };
+
+    struct Edge {
+        uint64_t target;  // address the edge leads to
+        uint32_t to;      // block index, or NO_BLOCK outside the region
+        EdgeKind kind;
+    };
+
+    struct Block {
+        uint64_t start;
+        uint64_t end;  // address after the last instruction
+        Disassembler::BranchKind exit;  // of the last instruction
+        bool valid;                     // false if the last word does not decode
+        uint8_t edgeCount;
+        uint32_t firstEdge;
+    };
+
+private:
+    // A word that ends its block: a control transfer or an invalid word.
+    struct Exit {
+        uint64_t index;
+        uint64_t target;
+        Disassembler::BranchKind kind;
+        bool hasTarget;
+        bool valid;
+    };
+
+    struct Chunk {
+        std::vector<Exit> exits;
+        std::vector<uint64_t> targets;
+    };
+
+    static constexpr std::size_t DECODE_BATCH = 256;
+
+    uint64_t basePc = 0;
+    std::size_t words = 0;
+    std::vector<uint64_t> targetIndex;
+    std::vector<Block> blockList;
+    std::vector<Edge> edgeList;
+    // One bit per word, set where a block starts, and the number of blocks that
+    // start before each 64-word group, so that block_at() is a popcount.
+    std::vector<uint64_t> leaderBits;
+    std::vector<uint32_t> leaderRank;
+
+    // Classifies the words in batches and decodes in full only the control
+    // transfers, which are a small part of typical code.
+    static void scan(const Disassembler &d, const uint32_t *words, std::size_t n, uint64_t base_pc,
+            std::size_t first, const FormatOptions &opt, Chunk &out) {
+        const auto &table = Disassembler::decoder(opt);
+        const uint64_t addressMask = opt.mode32 ? 0xffffffffULL : ~0ULL;
+        int32_t indices[DECODE_BATCH];
+        out.exits.clear();
+        out.targets.clear();
+        for (std::size_t at = 0; at < n; at += DECODE_BATCH) {
+            std::size_t m = std::min(DECODE_BATCH, n - at);
+            table.decode_batch(words + at, m, indices);
+            for (std::size_t i = 0; i < m; i++) {
+                std::size_t index = first + at + i;
+                if (indices[i] < 0) {
+                    out.exits.push_back({index, 0, Disassembler::BranchKind::NONE, false, false});
+                    continue;
+                }
+                if (Disassembler::format_info(table.entry(indices[i])->format).branch == Disassembler::BranchKind::NONE) {
+                    continue;
+                }
+                Disassembler::DecodedInst inst;
+                d.decode_inst(words[at + i], base_pc + 4 * (uint64_t)index, inst, opt);
+                uint64_t target = inst.target & addressMask;
+                out.exits.push_back({index, target, inst.branch, inst.hasTarget, true});
+                if (inst.hasTarget) {
+                    out.targets.push_back(target);
+                }
+            }
+        }
+        std::sort(out.targets.begin(), out.targets.end());
+        out.targets.erase(std::unique(out.targets.begin(), out.targets.end()), out.targets.end());
+    }
+
+    // Word index of addr if it is an instruction in the region.
+    bool word_index(uint64_t addr, std::size_t &index) const {
+        if (addr < basePc || (addr - basePc) % 4 != 0 || (addr - basePc) / 4 >= words) {
+            return false;
+        }
+        index = (addr - basePc) / 4;
+        return true;
+    }
+
+    void add_edge(Block &b, uint64_t target, uint32_t to, EdgeKind kind) {
+        edgeList.push_back({target, to, kind});
+        b.edgeCount++;
+    }
+
+public:
+    ControlFlowGraph() = default;
+
+    ControlFlowGraph(const Disassembler &d, const uint32_t *words, std::size_t n, uint64_t base_pc,
+            const FormatOptions &opt, const Options &options) {
+        build(d, words, n, base_pc, opt, options);
+    }
+
+    ControlFlowGraph(const Disassembler &d, const uint32_t *words, std::size_t n, uint64_t base_pc,
+            const FormatOptions &opt) : ControlFlowGraph(d, words, n, base_pc, opt, Options()) {}
+
+    // Recovers control flow of words[0..n) at base_pc, replacing any earlier result.
+    // Of the options only mode32 and reduced apply.
+    void build(const Disassembler &d, const uint32_t *words, std::size_t n, uint64_t base_pc,
+            const FormatOptions &opt, const Options &options) {
+        basePc = base_pc;
+        this->words = n;
+        targetIndex.clear();
+        blockList.clear();
+        edgeList.clear();
+        leaderBits.clear();
+        leaderRank.clear();
+        if (n == 0) {
+            return;
+        }
+
+        const std::size_t chunkWords = std::max<std::size_t>(options.chunkWords, 1);
+        const std::size_t chunks = (n + chunkWords - 1) / chunkWords;
+        unsigned int threads = options.threads ? options.threads : std::max(1U, std::thread::hardware_concurrency());
+        threads = std::min<std::size_t>(threads, chunks);
+
+        std::vector<Chunk> results(chunks);
+        std::atomic<std::size_t> next(0);
+        auto worker = [&] {
+            for (std::size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+                std::size_t at = c * chunkWords;
+                scan(d, words + at, std::min(chunkWords, n - at), base_pc, at, opt, results[c]);
+            }
+        };
+        if (threads <= 1) {
+            worker();
+        } else {
+            std::vector<std::thread> pool;
+            for (unsigned int t = 0; t < threads; t++) {
+                pool.emplace_back(worker);
+            }
+            for (std::thread &t : pool) {
+                t.join();
+            }
+        }
+
+        // Chunks are in address order, so their exits concatenate sorted.
+        std::vector<Exit> exits;
+        std::size_t exitCount = 0;
+        std::size_t targetCount = 0;
+        for (const Chunk &c : results) {
+            exitCount += c.exits.size();
+            targetCount += c.targets.size();
+        }
+        exits.reserve(exitCount);
+        targetIndex.reserve(targetCount);
+        for (Chunk &c : results) {
+            exits.insert(exits.end(), c.exits.begin(), c.exits.end());
+            targetIndex.insert(targetIndex.end(), c.targets.begin(), c.targets.end());
+            c = Chunk();
+        }
+        std::sort(targetIndex.begin(), targetIndex.end());
+        targetIndex.erase(std::unique(targetIndex.begin(), targetIndex.end()), targetIndex.end());
+
+        // Block leaders: the start, every target inside the region and the word
+        // after every exit, as one bit per word.
+        leaderBits.assign((n + 63) / 64, 0);
+        leaderBits[0] |= 1;
+        for (uint64_t target : targetIndex) {
+            std::size_t index;
+            if (word_index(target, index)) {
+                leaderBits[index / 64] |= 1ULL << (index % 64);
+            }
+        }
+        for (const Exit &e : exits) {
+            if (e.index + 1 < n) {
+                leaderBits[(e.index + 1) / 64] |= 1ULL << ((e.index + 1) % 64);
+            }
+        }
+        leaderRank.resize(leaderBits.size());
+        uint32_t blocks = 0;
+        for (std::size_t i = 0; i < leaderBits.size(); i++) {
+            leaderRank[i] = blocks;
+            blocks += __builtin_popcountll(leaderBits[i]);
+        }
+
+        blockList.reserve(blocks);
+        for (std::size_t i = 0; i < leaderBits.size(); i++) {
+            for (uint64_t bits = leaderBits[i]; bits; bits &= bits - 1) {
+                uint64_t start = base_pc + 4 * (uint64_t)(i * 64 + __builtin_ctzll(bits));
+                if (!blockList.empty()) {
+                    blockList.back().end = start;
+                }
+                blockList.push_back({start, 0, Disassembler::BranchKind::NONE, true, 0, 0});
+            }
+        }
+        blockList.back().end = base_pc + 4 * (uint64_t)n;
+
+        edgeList.reserve(2 * blockList.size());
+        auto e = exits.begin();
+        for (std::size_t i = 0; i < blockList.size(); i++) {
+            Block &b = blockList[i];
+            b.firstEdge = edgeList.size();
+            std::size_t last = (b.end - base_pc) / 4 - 1;
+            while (e != exits.end() && e->index < last) {
+                ++e;
+            }
+            if (e == exits.end() || e->index != last) {
+                if (b.end < base_pc + 4 * (uint64_t)n) {
+                    add_edge(b, b.end, i + 1, EdgeKind::FALLTHROUGH);
+                }
+                continue;
+            }
+            b.exit = e->kind;
+            b.valid = e->valid;
+            if (!e->valid) {
+                continue;
+            }
+            if (e->hasTarget) {
+                add_edge(b, e->target, block_at(e->target),
+                    e->kind == Disassembler::BranchKind::CALL ? EdgeKind::CALL : EdgeKind::BRANCH);
+            }
+            if ((e->kind == Disassembler::BranchKind::CONDITIONAL || e->kind == Disassembler::BranchKind::CALL) &&
+                    b.end < base_pc + 4 * (uint64_t)n) {
+                add_edge(b, b.end, i + 1, EdgeKind::FALLTHROUGH);
+            }
+        }
+    }
+
+    void build(const Disassembler &d, const uint32_t *words, std::size_t n, uint64_t base_pc, const FormatOptions &opt) {
+        build(d, words, n, base_pc, opt, Options());
+    }
+
+    uint64_t base() const {
+        return basePc;
+    }
+
+    // Region size in instructions.
+    std::size_t size() const {
+        return words;
+    }
+
+    // Every direct branch and call target, inside the region or not, sorted.
+    const std::vector<uint64_t> &targets() const {
+        return targetIndex;
+    }
+
+    bool is_target(uint64_t addr) const {
+        return std::binary_search(targetIndex.begin(), targetIndex.end(), addr);
+    }
+
+    const std::vector<Block> &blocks() const {
+        return blockList;
+    }
+
+    const std::vector<Edge> &edges() const {
+        return edgeList;
+    }
+
+    // Outgoing edges of a block, as a range of edges().
+    const Edge *edges_begin(const Block &b) const {
+        return edgeList.data() + b.firstEdge;
+    }
+
+    const Edge *edges_end(const Block &b) const {
+        return edgeList.data() + b.firstEdge + b.edgeCount;
+    }
+
+    // Index of the block containing addr, or NO_BLOCK. O(1).
+    uint32_t block_at(uint64_t addr) const {
+        std::size_t index;
+        if (!word_index(addr, index)) {
+            return NO_BLOCK;
+        }
+        uint64_t below = leaderBits[index / 64] & (~0ULL >> (63 - index % 64));
+        return leaderRank[index / 64] + __builtin_popcountll(below) - 1;
+    }
+
+    // Writes the label for addr ("L_80001234") the way disassemble_to() writes text:
+    // at most cap - 1 characters plus a NUL, returning the full length.
+    static std::size_t format_label(char *buf, std::size_t cap, uint64_t addr) {
+        TextWriter w(buf, cap);
+        w.put("L_", 2);
+        w.put_hex(addr, 8);
+        return w.finish();
+    }
+
+    static std::string label(uint64_t addr) {
+        char buf[24];
+        std::size_t n = format_label(buf, sizeof(buf), addr);
+        return std::string(buf, n);
+    }
+};
+
+}
+
+#endif
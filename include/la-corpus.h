@@ -0,0 +1,114 @@
+#ifndef __LADISASSEMBLER_CORPUS_H__
+#define __LADISASSEMBLER_CORPUS_H__
+
+#include "la-disassembler.h"
+
+#include <random>
+
+namespace LADisassembler {
+
+// Synthetic instruction streams for benchmarks and regression checks. Words are
+// drawn from the instruction table with random operand fields, so every opcode
+// can appear, or are raw random words.
+//
+//   UNIFORM   every table entry equally likely
+//   WEIGHTED  a mix resembling compiled integer code: loads, stores, addi,
+//             moves, branches and calls dominate, with 1 in 8 words uniform
+//   NOISE     random 32-bit words, most of which are not instructions
+//
+// In mode32 only LA32 instructions are generated. Streams are deterministic for a
+// given seed.
+class CorpusGenerator {
+public:
+    enum Kind {
+        UNIFORM,
+        WEIGHTED,
+        NOISE,
+    };
+
+private:
+    struct Weight {
+        Disassembler::Opcode opcode;
+        unsigned int weight;
+    };
+
+    std::mt19937 rng;
+    std::vector<Disassembler::Opcode> opcodes;
+    std::vector<Disassembler::Opcode> common;
+    std::vector<uint32_t> cumulative;
+
+    uint32_t encode(Disassembler::Opcode opcode) {
+        BitPat pattern = Disassembler::pattern(opcode);
+        return (uint32_t)pattern.get_bits() | ((uint32_t)rng() & ~(uint32_t)pattern.get_mask());
+    }
+
+public:
+    explicit CorpusGenerator(uint32_t seed = 1, bool mode32 = false) : rng(seed) {
+        using Op = Disassembler::Opcode;
+        static const Weight weights[] = {
+            {Op::ADDI_D, 12}, {Op::LD_D, 10}, {Op::ST_D, 8}, {Op::OR, 6},
+            {Op::ADDI_W, 5}, {Op::LD_W, 5}, {Op::ST_W, 4}, {Op::ADD_D, 4},
+            {Op::BL, 4}, {Op::JIRL, 4}, {Op::BEQZ, 3}, {Op::BNEZ, 3},
+            {Op::BEQ, 3}, {Op::BNE, 3}, {Op::B, 3}, {Op::ANDI, 3},
+            {Op::PCALAU12I, 3}, {Op::LU12I_W, 2}, {Op::PCADDU12I, 2}, {Op::ADD_W, 2},
+            {Op::SUB_D, 2}, {Op::SLLI_D, 2}, {Op::SRLI_D, 1}, {Op::SLLI_W, 1},
+            {Op::LD_BU, 2}, {Op::ST_B, 1}, {Op::LD_HU, 1}, {Op::LDX_D, 1},
+            {Op::BLT, 1}, {Op::BGE, 1}, {Op::BLTU, 1}, {Op::BGEU, 1},
+            {Op::SLTU, 1}, {Op::SLTUI, 1}, {Op::MASKEQZ, 1}, {Op::MUL_D, 1},
+            {Op::ORI, 1}, {Op::LU32I_D, 1}, {Op::LU52I_D, 1}, {Op::BSTRPICK_D, 1},
+        };
+        for (std::size_t i = 0; i < (std::size_t)Disassembler::Opcode::COUNT; i++) {
+            Disassembler::Opcode opcode = (Disassembler::Opcode)i;
+            if (!mode32 || Disassembler::isa_level(opcode) <= Disassembler::LA32) {
+                opcodes.push_back(opcode);
+            }
+        }
+        uint32_t total = 0;
+        for (const Weight &w : weights) {
+            if (!mode32 || Disassembler::isa_level(w.opcode) <= Disassembler::LA32) {
+                total += w.weight;
+                common.push_back(w.opcode);
+                cumulative.push_back(total);
+            }
+        }
+    }
+
+    static const char *name(Kind kind) {
+        switch (kind) {
+            case UNIFORM: return "uniform";
+            case WEIGHTED: return "weighted";
+            case NOISE: return "noise";
+        }
+        return "";
+    }
+
+    uint32_t next(Kind kind) {
+        switch (kind) {
+            case UNIFORM:
+                return encode(opcodes[rng() % opcodes.size()]);
+            case WEIGHTED:
+                if (rng() % 8 == 0) {
+                    return encode(opcodes[rng() % opcodes.size()]);
+                } else {
+                    uint32_t r = rng() % cumulative.back();
+                    std::size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), r) - cumulative.begin();
+                    return encode(common[i]);
+                }
+            case NOISE:
+                return rng();
+        }
+        return 0;
+    }
+
+    std::vector<uint32_t> generate(Kind kind, std::size_t n) {
+        std::vector<uint32_t> words(n);
+        for (uint32_t &w : words) {
+            w = next(kind);
+        }
+        return words;
+    }
+};
+
+}
+
+#endif
@@ -5,8 +5,27 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
-#include <functional>
+#include <utility>
+#include <array>
 #include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define __LADISASSEMBLER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Define LADISASSEMBLER_STATS to count decoder hits and misses and time decoding
+// and formatting (see Disassembler::stats()). Without it the counting code is not
+// compiled at all and stats() reports zeros. The macro changes class layouts and
+// inline function bodies, so every translation unit of a program must agree on it.
+#ifdef LADISASSEMBLER_STATS
+#include <atomic>
+#include <chrono>
+#define __LADISASSEMBLER_STAT(...) __VA_ARGS__
+#else
+#define __LADISASSEMBLER_STAT(...)
+#endif
 
 namespace LADisassembler {
 
@@ -17,16 +36,22 @@ private:
     unsigned int length;
 
 public:
-    BitPat(const std::string &s) {
+    // constexpr so that pattern tables can be parsed at compile time; an invalid
+    // pattern in a constant expression then fails to compile instead of logging.
+    constexpr BitPat(const char *s) : bits(0), mask(0), length(0) {
+        std::size_t n = 0;
+        while (s[n] != '\0') {
+            n++;
+        }
         uint64_t bits = 0;
         uint64_t mask = 0;
-        int length = 0;
-        for (int i = s.length() - 1; i >= 0; i--) {
+        unsigned int length = 0;
+        for (std::size_t i = n; i-- > 0; ) {
             switch (s[i]) {
                 case '0': length++; break;
-                case '1': bits |= 1 << length; length++; break;
-                case 'x': mask |= 1 << length; length++; break;
-                case '?': mask |= 1 << length; length++; break;
+                case '1': if (length < 64) bits |= 1ULL << length; length++; break;
+                case 'x': if (length < 64) mask |= 1ULL << length; length++; break;
+                case '?': if (length < 64) mask |= 1ULL << length; length++; break;
                 case '_': break;
                 case ' ': break;
                 default: std::cerr << "BitPat: invalid character in pattern" << std::endl; break;
@@ -35,25 +60,75 @@ public:
         if (length > 64) {
             std::cerr << "BitPat: pattern too long" << std::endl;
         }
-                
+
         for (std::size_t i = length; i < 64; i++) {
-            mask |= 1UL << i;
+            mask |= 1ULL << i;
         }
-        
+
         this->bits = bits;
         this->mask = ~mask; // mask is 0 for match any bit
         this->length = length;
     }
+
+    BitPat(const std::string &s) : BitPat(s.c_str()) {}
         
-    unsigned int get_length() const {
+    constexpr unsigned int get_length() const {
         return this->length;
     }
+
+    constexpr uint64_t get_bits() const {
+        return this->bits;
+    }
+
+    constexpr uint64_t get_mask() const {
+        return this->mask;
+    }
+
+    constexpr bool overlaps(const BitPat &other) const {
+        return ((this->bits ^ other.bits) & this->mask & other.mask) == 0;
+    }
         
-    bool match(uint64_t data) const {
+    // True if every word this pattern matches is also matched by other, which is
+    // more general: a special case listed ahead of the general form.
+    constexpr bool specializes(const BitPat &other) const {
+        return overlaps(other) && (other.mask & ~this->mask) == 0 && other.mask != this->mask;
+    }
+
+    constexpr bool match(uint64_t data) const {
         return (data & this->mask) == this->bits;
     }
 };
         
+#ifdef LADISASSEMBLER_STATS
+// Time stamp for the stats: the TSC where there is one, else nanoseconds.
+inline uint64_t stat_cycles() {
+#ifdef __LADISASSEMBLER_X86_SIMD
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Adds the time from construction to destruction to cycles, and n to count.
+class StatTimer {
+private:
+    std::atomic<uint64_t> &cycles;
+    std::atomic<uint64_t> &count;
+    uint64_t n;
+    uint64_t start;
+
+public:
+    StatTimer(std::atomic<uint64_t> &cycles, std::atomic<uint64_t> &count, uint64_t n = 1)
+        : cycles(cycles), count(count), n(n), start(stat_cycles()) {}
+
+    ~StatTimer() {
+        cycles.fetch_add(stat_cycles() - start, std::memory_order_relaxed);
+        count.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+#endif
+
 template<typename entry_t>
 class Decoder {
 private:
@@ -63,333 +138,543 @@ private:
     };
     std::vector<Entry> patterns;
 
+    // Compiled decode tree, one packed 32-bit word per node:
+    //   inner: [31] = 0, [30:25] = field shift, [24:22] = field width - 1, [21:0] = first child
+    //   leaf:  [31] = 1, [30:24] = candidate count, [23:0] = first candidate in leafEntries
+    // An inner node jumps on a field of opcode bits that its candidates all care about;
+    // a leaf lists the remaining candidates in table order, so first-match-wins still holds.
+    static constexpr uint32_t NODE_LEAF = 1U << 31;
+    static constexpr unsigned int MAX_FIELD_WIDTH = 8;
+    static constexpr unsigned int MAX_LEAF_COUNT = 0x7f;
+
+    std::vector<uint32_t> nodes;
+    std::vector<uint32_t> leafEntries;
+    uint32_t root = NODE_LEAF;
+    unsigned int depth = 0;
+    bool built = false;
+    // 32-bit copies of the pattern bits and masks for the vectorized batch path.
+    std::vector<uint32_t> bits32;
+    std::vector<uint32_t> masks32;
+    std::vector<std::pair<unsigned int, unsigned int>> overlapping;
+
+public:
+    // Matches are binned by how many leaf candidates were tried before the hit; the
+    // last bin takes that many or more.
+    static constexpr unsigned int STAT_POSITIONS = 8;
+
+    struct Stats {
+        std::vector<uint64_t> hits;  // per pattern index
+        uint64_t misses = 0;
+        uint64_t positions[STAT_POSITIONS] = {};
+    };
+
+private:
+#ifdef LADISASSEMBLER_STATS
+    // Relaxed atomics so that threads can share the decoder. A copy starts from
+    // zero, so copying a decoder works as without stats and counts only its own
+    // lookups.
+    struct Counters {
+        std::vector<std::atomic<uint64_t>> hits;
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> positions[STAT_POSITIONS] = {};
+
+        Counters() = default;
+
+        Counters(const Counters &other) : hits(other.hits.size()) {}
+
+        Counters &operator=(const Counters &other) {
+            hits = std::vector<std::atomic<uint64_t>>(other.hits.size());
+            reset();
+            return *this;
+        }
+
+        void reset() {
+            for (std::atomic<uint64_t> &h : hits) {
+                h.store(0, std::memory_order_relaxed);
+            }
+            misses.store(0, std::memory_order_relaxed);
+            for (std::atomic<uint64_t> &p : positions) {
+                p.store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+    // Sized by build().
+    mutable Counters counters;
+
+    void record(int index, unsigned int position) const {
+        if (index < 0) {
+            counters.misses.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        counters.hits[index].fetch_add(1, std::memory_order_relaxed);
+        counters.positions[std::min(position, STAT_POSITIONS - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+
+    uint64_t length_mask() const {
+        return fixedLength >= 64 ? ~0ULL : (1ULL << fixedLength) - 1;
+    }
+
+    uint32_t make_leaf(const std::vector<uint32_t> &candidates) {
+        if (candidates.size() > MAX_LEAF_COUNT || leafEntries.size() >= (1U << 24)) {
+            std::cerr << "Decoder: decode tree leaf overflow" << std::endl;
+            return NODE_LEAF;
+        }
+        uint32_t start = leafEntries.size();
+        leafEntries.insert(leafEntries.end(), candidates.begin(), candidates.end());
+        return NODE_LEAF | (uint32_t)candidates.size() << 24 | start;
+    }
+
+    uint32_t build_node(const std::vector<uint32_t> &candidates, uint64_t decided, unsigned int level) {
+        depth = std::max(depth, level);
+        if (candidates.empty()) {
+            return NODE_LEAF;
+        }
+
+        // The first candidate is fully decided by the path: it matches everything reaching here.
+        if ((patterns[candidates[0]].pattern.get_mask() & ~decided) == 0) {
+            return make_leaf({candidates[0]});
+        }
+        if (candidates.size() == 1) {
+            return make_leaf(candidates);
+        }
+
+        uint64_t common = length_mask() & ~decided;
+        for (uint32_t c : candidates) {
+            common &= patterns[c].pattern.get_mask();
+        }
+
+        unsigned int shift = 0;
+        unsigned int width = 0;
+        if (common != 0) {
+            // Longest run of bits every candidate cares about, highest run on ties.
+            for (unsigned int lo = 0; lo < 64; lo++) {
+                if (!(common >> lo & 1)) continue;
+                unsigned int hi = lo;
+                while (hi + 1 < 64 && (common >> (hi + 1) & 1)) hi++;
+                if (hi - lo + 1 >= width) {
+                    width = hi - lo + 1;
+                    shift = lo;
+                }
+                lo = hi;
+            }
+            if (width > MAX_FIELD_WIDTH) {
+                shift += width - MAX_FIELD_WIDTH;
+                width = MAX_FIELD_WIDTH;
+            }
+        } else {
+            // No shared bits left: split on the bit most candidates care about and
+            // let the ones that don't care follow both ways.
+            unsigned int best = 0;
+            for (unsigned int b = 0; b < fixedLength; b++) {
+                if (decided >> b & 1) continue;
+                unsigned int n = 0;
+                for (uint32_t c : candidates) {
+                    n += patterns[c].pattern.get_mask() >> b & 1;
+                }
+                if (n > best) {
+                    best = n;
+                    shift = b;
+                }
+            }
+            width = 1;
+        }
+
+        if (nodes.size() + (1U << width) > (1U << 22)) {
+            std::cerr << "Decoder: decode tree too large" << std::endl;
+            return make_leaf(std::vector<uint32_t>(candidates.begin(), candidates.begin() + std::min<std::size_t>(candidates.size(), MAX_LEAF_COUNT)));
+        }
+
+        uint64_t field = ((1ULL << width) - 1) << shift;
+        uint32_t base = nodes.size();
+        nodes.resize(base + (1U << width));
+        std::vector<uint32_t> sub;
+        for (uint32_t v = 0; v < (1U << width); v++) {
+            sub.clear();
+            for (uint32_t c : candidates) {
+                const BitPat &p = patterns[c].pattern;
+                if ((((uint64_t)v << shift ^ p.get_bits()) & p.get_mask() & field) == 0) {
+                    sub.push_back(c);
+                }
+            }
+            uint32_t child = build_node(sub, decided | field, level + 1);
+            nodes[base + v] = child;
+        }
+        return shift << 25 | (width - 1) << 22 | base;
+    }
+
 public:
     unsigned int fixedLength = 0;
         
-    bool add(const std::string &pattern, const entry_t &entry) {
+    bool add(const BitPat &pattern, const entry_t &entry) {
         if (patterns.empty()) {
-            fixedLength = BitPat(pattern).get_length();
+            fixedLength = pattern.get_length();
         } else {
-            if (fixedLength != BitPat(pattern).get_length()) {
+            if (fixedLength != pattern.get_length()) {
                 std::cerr << "Decoder: pattern length mismatch" << std::endl;
                 return false;
             }
         }
-        patterns.push_back({BitPat(pattern), entry});
+        patterns.push_back({pattern, entry});
+        built = false;
         return true;
     }
-        
-    bool decode(uint64_t bits, entry_t &e) const {
-        for (const Entry &p : patterns) {
-            if (p.pattern.match(bits)) {
-                e = p.entry;
-                return true;
+
+    bool add(const char *pattern, const entry_t &entry) {
+        return add(BitPat(pattern), entry);
+    }
+
+    bool add(const std::string &pattern, const entry_t &entry) {
+        return add(BitPat(pattern), entry);
+    }
+
+    // Compiles the registered patterns into the decode tree and reports overlapping pairs
+    // other than special cases listed ahead of their general form, which first-match-wins
+    // resolves as intended. Returns the number of overlapping pairs found, of either kind.
+    unsigned int build() {
+        nodes.clear();
+        leafEntries.clear();
+        overlapping.clear();
+
+        for (unsigned int j = 0; j < patterns.size(); j++) {
+            for (unsigned int i = 0; i < j; i++) {
+                if (patterns[i].pattern.overlaps(patterns[j].pattern)) {
+                    overlapping.push_back({i, j});
+                    if (!patterns[i].pattern.specializes(patterns[j].pattern)) {
+                        std::cerr << "Decoder: pattern " << j << " overlaps pattern " << i << std::endl;
+                    }
+                }
             }
         }
-        return false;
-    }
-        
-    unsigned int count() const {
-        return patterns.size();
+
+        std::vector<uint32_t> all(patterns.size());
+        for (uint32_t i = 0; i < all.size(); i++) {
+            all[i] = i;
+        }
+        depth = 0;
+        root = build_node(all, ~length_mask(), 0);
+
+        bits32.clear();
+        masks32.clear();
+        if (fixedLength <= 32) {
+            for (const Entry &e : patterns) {
+                bits32.push_back(e.pattern.get_bits());
+                masks32.push_back(e.pattern.get_mask());
+            }
+        }
+        __LADISASSEMBLER_STAT(
+            counters.hits = std::vector<std::atomic<uint64_t>>(patterns.size());
+            counters.reset();
+        )
+        built = true;
+        return overlapping.size();
     }
-};
 
-class Disassembler {
-public:
-    enum TokenType {
-        NAME,   // str
-        RD,     // num
-        RJ,     // num
-        RK,     // num
-        UIMM32, // num
-        SIMM32, // num
-        UIMM64, // num
-        SIMM64, // num
-        PCOFF,  // num
-        BASEREG, // num
-        ADDROFF, // num
-        END,
-    };
-    
-    struct DecodeToken {
-        TokenType type = END;
-        union {
-            const char *str;
-            uint64_t num;
-        };
-    };
-    
-    struct DecodeTokenArray {
-        DecodeToken tokens[4];
-    };
+    // Pairs (earlier, later) of patterns that match at least one common word.
+    const std::vector<std::pair<unsigned int, unsigned int>> &overlaps() const {
+        return overlapping;
+    }
 
-private:
-    static std::string to_hex(uint64_t n) {
-        static const char *hexDigits = "0123456789abcdef";
+    // Index of the first matching pattern in registration order, or -1.
+    int decode_index(uint64_t bits) const {
+        if (!built) {
+            return decode_index_linear(bits);
+        }
+        uint32_t node = root;
+        while (!(node & NODE_LEAF)) {
+            unsigned int shift = node >> 25 & 0x3f;
+            unsigned int width = (node >> 22 & 0x7) + 1;
+            node = nodes[(node & 0x3fffff) + (bits >> shift & ((1U << width) - 1))];
+        }
+        uint32_t start = node & 0xffffff;
+        uint32_t end = start + (node >> 24 & MAX_LEAF_COUNT);
+        for (uint32_t i = start; i < end; i++) {
+            if (patterns[leafEntries[i]].pattern.match(bits)) {
+                __LADISASSEMBLER_STAT(record(leafEntries[i], i - start);)
+                return leafEntries[i];
+            }
+        }
+        __LADISASSEMBLER_STAT(record(-1, 0);)
+        return -1;
+    }
 
-        if (n == 0) {
-            return "0";
+    // Reference linear scan, kept to validate the decode tree against.
+    int decode_index_linear(uint64_t bits) const {
+        for (std::size_t i = 0; i < patterns.size(); i++) {
+            if (patterns[i].pattern.match(bits)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+        
+    // Classifies n words into pattern indices (-1 for no match), same as decode_index().
+    // Uses an AVX2 walk of the decode tree when the CPU has it, else the scalar path.
+    void decode_batch(const uint32_t *words, std::size_t n, int32_t *indices) const {
+#ifdef __LADISASSEMBLER_X86_SIMD
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if (avx2 && built && fixedLength <= 32) {
+            decode_batch_avx2(words, n, indices);
+            return;
         }
+#endif
+        decode_batch_scalar(words, n, indices);
+    }
 
-        std::string hexString;
-        while (n > 0) {
-            int remainder = n % 16;
-            hexString += hexDigits[remainder];
-            n /= 16;
+    void decode_batch_scalar(const uint32_t *words, std::size_t n, int32_t *indices) const {
+        for (std::size_t i = 0; i < n; i++) {
+            indices[i] = decode_index(words[i]);
         }
+    }
+
+#ifdef __LADISASSEMBLER_X86_SIMD
+    // Walks the tree for 8 words at a time with gathers, one level per step. Leaves
+    // holding a single candidate are verified in-vector; lanes that reach a leaf with
+    // several candidates are finished by the scalar leaf scan.
+    __attribute__((target("avx2")))
+    void decode_batch_avx2(const uint32_t *words, std::size_t n, int32_t *indices) const {
+        const int *nodeTable = (const int *)nodes.data();
+        const int *leafTable = (const int *)leafEntries.data();
+        const int *bitsTable = (const int *)bits32.data();
+        const int *maskTable = (const int *)masks32.data();
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i miss = _mm256_set1_epi32(-1);
+
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+            __m256i node = _mm256_set1_epi32(root);
+            for (unsigned int level = 0; level < depth; level++) {
+                __m256i inner = _mm256_cmpgt_epi32(node, miss); // bit 31 clear
+                if (_mm256_testz_si256(inner, inner)) {
+                    break;
+                }
+                __m256i shift = _mm256_and_si256(_mm256_srli_epi32(node, 25), _mm256_set1_epi32(0x3f));
+                __m256i width = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(node, 22), _mm256_set1_epi32(0x7)), one);
+                __m256i field = _mm256_and_si256(_mm256_srlv_epi32(w, shift), _mm256_sub_epi32(_mm256_sllv_epi32(one, width), one));
+                __m256i index = _mm256_add_epi32(_mm256_and_si256(node, _mm256_set1_epi32(0x3fffff)), field);
+                node = _mm256_mask_i32gather_epi32(node, nodeTable, index, inner, 4);
+            }
 
-        std::reverse(hexString.begin(), hexString.end());
+            __m256i count = _mm256_and_si256(_mm256_srli_epi32(node, 24), _mm256_set1_epi32(MAX_LEAF_COUNT));
+            __m256i start = _mm256_and_si256(node, _mm256_set1_epi32(0xffffff));
+            __m256i single = _mm256_cmpeq_epi32(count, one);
+            __m256i cand = _mm256_mask_i32gather_epi32(miss, leafTable, start, single, 4);
+            __m256i bits = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), bitsTable, cand, single, 4);
+            __m256i mask = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), maskTable, cand, single, 4);
+            __m256i hit = _mm256_and_si256(single, _mm256_cmpeq_epi32(_mm256_and_si256(w, mask), bits));
+            _mm256_storeu_si256((__m256i *)(indices + i), _mm256_blendv_epi8(miss, cand, hit));
 
-        return hexString;
-    } 
+            int several = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(count, one)));
+            __LADISASSEMBLER_STAT(
+                for (int lane = 0; lane < 8; lane++) {
+                    if (!(several >> lane & 1)) {
+                        record(indices[i + lane], 0);
+                    }
+                }
+            )
+            while (several) {
+                int lane = __builtin_ctz(several);
+                several &= several - 1;
+                indices[i + lane] = decode_index(words[i + lane]);
+            }
+        }
+        decode_batch_scalar(words + i, n - i, indices + i);
+    }
+#endif
 
-    bool hexImm = false;
-    bool regAlias = false;
-    bool regPrefix = false;
-    bool instAlias = true;
-    bool mode32 = false;
+    // Payload of the pattern at index, as returned by decode_index().
+    const entry_t &entry(unsigned int index) const {
+        return patterns[index].entry;
+    }
 
-    struct DecoderEntry {
-        std::function<void (const Disassembler *, uint32_t, const void*, DecodeTokenArray &)> disasmFunc;
-        const void* args;
-    };
-    
-    Decoder<DecoderEntry> decoder;
-    bool decode(uint32_t inst, DecodeTokenArray &tokens) const {
-        DecoderEntry entry;
-        bool success = decoder.decode(inst, entry);
-        if (!success) {
+    bool decode(uint64_t bits, entry_t &e) const {
+        int index = decode_index(bits);
+        if (index < 0) {
             return false;
         }
-        entry.disasmFunc(this, inst, entry.args, tokens);
+        e = patterns[index].entry;
         return true;
     }
+        
+    unsigned int count() const {
+        return patterns.size();
+    }
 
-    #define __BITS(hi, lo) ((inst >> (lo)) & ((1 << ((hi) - (lo) + 1)) - 1))
-    #define __SEXT(bits, from) ((int64_t)(((int64_t)(bits)) << (64 - (from))) >> (64 - (from)))
-    #define __SIMM(hi, lo) __SEXT(__BITS(hi, lo), (hi) - (lo) + 1)
-
-    void disasm_3R(uint32_t inst, const void *args, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)args;
-        tokens.tokens[1].type = RD;
-        tokens.tokens[1].num = __BITS(4, 0);
-        tokens.tokens[2].type = RJ;
-        tokens.tokens[2].num = __BITS(9, 5);
-        tokens.tokens[3].type = RK;
-        tokens.tokens[3].num = __BITS(14, 10);
-    }
-
-    void disasm_2RI12(uint32_t inst, const void *args, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)args;
-        tokens.tokens[1].type = RD;
-        tokens.tokens[1].num = __BITS(4, 0);
-        tokens.tokens[2].type = RJ;
-        tokens.tokens[2].num = __BITS(9, 5);
-        tokens.tokens[3].type = SIMM32;
-        tokens.tokens[3].num = __SIMM(21, 10);
-    }
-
-    void disasm_2RI14(uint32_t inst, const void *args, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)args;
-        tokens.tokens[1].type = RD;
-        tokens.tokens[1].num = __BITS(4, 0);
-        tokens.tokens[2].type = RJ;
-        tokens.tokens[2].num = __BITS(9, 5);
-        tokens.tokens[3].type = SIMM32;
-        tokens.tokens[3].num = __SIMM(23, 10);
-    }
-
-    void disasm_shifti_w(uint32_t inst, const void *args, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)args;
-        tokens.tokens[1].type = RD;
-        tokens.tokens[1].num = __BITS(4, 0);
-        tokens.tokens[2].type = RJ;
-        tokens.tokens[2].num = __BITS(9, 5);
-        tokens.tokens[3].type = UIMM32;
-        tokens.tokens[3].num = __BITS(14, 10);
-    }
-
-    void disasm_12UI(uint32_t inst, const void *args, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)args;
-        tokens.tokens[1].type = RD;
-        tokens.tokens[1].num = __BITS(4, 0);
-        tokens.tokens[2].type = UIMM32;
-        tokens.tokens[2].num = __BITS(24, 5) << 12;
-    }
-
-    void disasm_branch(uint32_t inst, const void *args, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)args;
-        tokens.tokens[1].type = RJ;
-        tokens.tokens[1].num = __BITS(9, 5);
-        tokens.tokens[2].type = RK;
-        tokens.tokens[2].num = __BITS(4, 0);
-        tokens.tokens[3].type = PCOFF;
-        tokens.tokens[3].num = __SIMM(25, 10) << 2;
-    }
-
-    void disasm_jirl(uint32_t inst, const void *, DecodeTokenArray &tokens) const {
-        if (inst == 0x4c000020 && instAlias) {
-            tokens.tokens[0].type = NAME;
-            tokens.tokens[0].str = "ret";
-            tokens.tokens[1].type = END;
-        } else {
-            tokens.tokens[0].type = NAME;
-            tokens.tokens[0].str = "jirl";
-            tokens.tokens[1].type = RD;
-            tokens.tokens[1].num = __BITS(4, 0);
-            tokens.tokens[2].type = RJ;
-            tokens.tokens[2].num = __BITS(9, 5);
-            tokens.tokens[3].type = PCOFF;
-            tokens.tokens[3].num = __SIMM(24, 10);
+    // Counts since the last reset_stats(); all zero without LADISASSEMBLER_STATS or
+    // before build().
+    Stats stats() const {
+        Stats s;
+        s.hits.assign(patterns.size(), 0);
+#ifdef LADISASSEMBLER_STATS
+        for (std::size_t i = 0; i < s.hits.size() && i < counters.hits.size(); i++) {
+            s.hits[i] = counters.hits[i].load(std::memory_order_relaxed);
         }
+        s.misses = counters.misses.load(std::memory_order_relaxed);
+        for (unsigned int i = 0; i < STAT_POSITIONS; i++) {
+            s.positions[i] = counters.positions[i].load(std::memory_order_relaxed);
+        }
+#endif
+        return s;
     }
 
-    void disasm_b(uint32_t inst, const void *, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = "b";
-        tokens.tokens[1].type = PCOFF;
-        tokens.tokens[1].num = __SEXT(__BITS(9, 0) << 16 | __BITS(24, 10), 26);
+    void reset_stats() const {
+#ifdef LADISASSEMBLER_STATS
+        counters.reset();
+#endif
     }
 
-    void disasm_bl(uint32_t inst, const void *, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = instAlias ? "call" : "bl";
-        tokens.tokens[1].type = PCOFF;
-        tokens.tokens[1].num = __SEXT(((__BITS(9, 0) << 15) | __BITS(25, 10)) << 2, 24);
+    // Size of what a lookup may touch: tree nodes, leaf lists and patterns.
+    std::size_t table_bytes() const {
+        return nodes.size() * sizeof(uint32_t) + leafEntries.size() * sizeof(uint32_t) + patterns.size() * sizeof(Entry);
     }
 
-    void disasm_load(uint32_t inst, const void *name, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)name;
-        tokens.tokens[1].type = RD;
-        tokens.tokens[1].num = __BITS(4, 0);
-        tokens.tokens[2].type = BASEREG;
-        tokens.tokens[2].num = __BITS(9, 5);
-        tokens.tokens[3].type = ADDROFF;
-        tokens.tokens[3].num = __SIMM(21, 10);
+    unsigned int tree_depth() const {
+        return depth;
     }
+};
 
-    void disasm_store(uint32_t inst, const void *name, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char*)name;
-        tokens.tokens[1].type = RJ;
-        tokens.tokens[1].num = __BITS(4, 0);
-        tokens.tokens[2].type = BASEREG;
-        tokens.tokens[2].num = __BITS(9, 5);
-        tokens.tokens[3].type = ADDROFF;
-        tokens.tokens[3].num = __SIMM(21, 10);
-    }
+// Two-character decimal and hex digit tables for TextWriter.
+struct DigitPairs {
+    char dec[200];
+    char hex[512];
 
-    void disasm_15I(uint32_t inst, const void *name, DecodeTokenArray &tokens) const {
-        tokens.tokens[0].type = NAME;
-        tokens.tokens[0].str = (const char *)name;
-        tokens.tokens[1].type = UIMM32;
-        tokens.tokens[1].num = __BITS(14, 0);
+    constexpr DigitPairs() : dec(), hex() {
+        for (int i = 0; i < 100; i++) {
+            dec[2 * i] = '0' + i / 10;
+            dec[2 * i + 1] = '0' + i % 10;
+        }
+        for (int i = 0; i < 256; i++) {
+            hex[2 * i] = "0123456789abcdef"[i >> 4];
+            hex[2 * i + 1] = "0123456789abcdef"[i & 0xf];
+        }
     }
+};
 
-    #undef __SIMM
-    #undef __SEXT
-    #undef __BITS
+// Bounded text cursor over a caller-provided buffer. Writes at most cap - 1
+// characters and NUL-terminates, but keeps counting past the end so that the
+// caller learns the full length, like snprintf. Never allocates.
+class TextWriter {
+private:
+    static constexpr DigitPairs digitPairs{};
+
+    char *buf;
+    std::size_t cap;
+    std::size_t len = 0;
 
 public:
-    Disassembler() {
-        #define __INSTPAT_NAME(pattern, func, name) this->decoder.add(pattern, {&Disassembler::func, #name});
-        #define __INSTPAT_NONE(pattern, func) this->decoder.add(pattern, {&Disassembler::func, nullptr});
-
-        __INSTPAT_NAME("0000000000 0100000 ????? ????? ?????", disasm_3R, add.w  );
-        __INSTPAT_NAME("0000000000 0100001 ????? ????? ?????", disasm_3R, add.d  );
-        __INSTPAT_NAME("0000000000 0100010 ????? ????? ?????", disasm_3R, sub.w  );
-        __INSTPAT_NAME("0000000000 0100011 ????? ????? ?????", disasm_3R, sub.d  );
-        __INSTPAT_NAME("0000000000 0100100 ????? ????? ?????", disasm_3R, slt    );
-        __INSTPAT_NAME("0000000000 0100101 ????? ????? ?????", disasm_3R, sltu   );
-        __INSTPAT_NAME("0000000000 0100110 ????? ????? ?????", disasm_3R, maskeqz);
-        __INSTPAT_NAME("0000000000 0100111 ????? ????? ?????", disasm_3R, masknez);
-        __INSTPAT_NAME("0000000000 0101000 ????? ????? ?????", disasm_3R, nor    );
-        __INSTPAT_NAME("0000000000 0101001 ????? ????? ?????", disasm_3R, and    );
-        __INSTPAT_NAME("0000000000 0101010 ????? ????? ?????", disasm_3R, or     );
-        __INSTPAT_NAME("0000000000 0101011 ????? ????? ?????", disasm_3R, xor    );
-        __INSTPAT_NAME("0000000000 0101100 ????? ????? ?????", disasm_3R, orn    );
-        __INSTPAT_NAME("0000000000 0101101 ????? ????? ?????", disasm_3R, andn   );
-        __INSTPAT_NAME("0000000000 0101110 ????? ????? ?????", disasm_3R, sll.w  );
-        __INSTPAT_NAME("0000000000 0101111 ????? ????? ?????", disasm_3R, srl.w  );
-        __INSTPAT_NAME("0000000000 0110000 ????? ????? ?????", disasm_3R, sra.w  );
-        __INSTPAT_NAME("0000000000 0110001 ????? ????? ?????", disasm_3R, sll.d  );
-        __INSTPAT_NAME("0000000000 0110010 ????? ????? ?????", disasm_3R, srl.d  );
-        __INSTPAT_NAME("0000000000 0110011 ????? ????? ?????", disasm_3R, sra.d  );
-        
-        __INSTPAT_NAME("0000000000 0111000 ????? ????? ?????", disasm_3R, mul.w  );
-        __INSTPAT_NAME("0000000000 0111001 ????? ????? ?????", disasm_3R, mulh.w );
-        __INSTPAT_NAME("0000000000 0111010 ????? ????? ?????", disasm_3R, mulhu.w);
-        __INSTPAT_NAME("0000000000 1000000 ????? ????? ?????", disasm_3R, div.w  );
-        __INSTPAT_NAME("00000000001 000001 ????? ????? ?????", disasm_3R, mod.w  );
-        __INSTPAT_NAME("0000000000 1000010 ????? ????? ?????", disasm_3R, div.wu );
-        __INSTPAT_NAME("0000000000 1000011 ????? ????? ?????", disasm_3R, mod.wu );
-
-        __INSTPAT_NAME("000000 1010 ???????????? ????? ?????", disasm_2RI12, addi.w);
-        __INSTPAT_NAME("000000 1000 ???????????? ????? ?????", disasm_2RI12, slti  );
-        __INSTPAT_NAME("000000 1001 ???????????? ????? ?????", disasm_2RI12, sltiu );
-        __INSTPAT_NAME("000000 1101 ???????????? ????? ?????", disasm_2RI12, andi  );
-        __INSTPAT_NAME("000000 1110 ???????????? ????? ?????", disasm_2RI12, ori   );
-        __INSTPAT_NAME("000000 1111 ???????????? ????? ?????", disasm_2RI12, xori  );
-
-        __INSTPAT_NAME("00000000010000 001 ????? ????? ?????", disasm_shifti_w, slli.w);
-        __INSTPAT_NAME("00000000010001 001 ????? ????? ?????", disasm_shifti_w, srli.w);
-        __INSTPAT_NAME("00000000010010 001 ????? ????? ?????", disasm_shifti_w, srai.w);
-
-        __INSTPAT_NAME("0001010 ???????????????????? ?????", disasm_12UI, lu12i.w  );
-        __INSTPAT_NAME("0001110 ???????????????????? ?????", disasm_12UI, pcaddu12i);
-
-        __INSTPAT_NAME("010110 ???????????????? ????? ?????", disasm_branch, beq );
-        __INSTPAT_NAME("010111 ???????????????? ????? ?????", disasm_branch, bne );
-        __INSTPAT_NAME("011000 ???????????????? ????? ?????", disasm_branch, blt );
-        __INSTPAT_NAME("011001 ???????????????? ????? ?????", disasm_branch, bge );
-        __INSTPAT_NAME("011010 ???????????????? ????? ?????", disasm_branch, bltu);
-        __INSTPAT_NAME("011011 ???????????????? ????? ?????", disasm_branch, bgeu);
-
-        __INSTPAT_NONE("010011 ???????????????? ????? ?????", disasm_jirl);
-        __INSTPAT_NONE("010100 ???????????????? ????? ?????", disasm_b   );
-        __INSTPAT_NONE("010101 ???????????????? ????? ?????", disasm_bl  );
-
-        __INSTPAT_NAME("00101 00000 ???????????? ????? ?????", disasm_load , ld.b );
-        __INSTPAT_NAME("00101 00001 ???????????? ????? ?????", disasm_load , ld.h );
-        __INSTPAT_NAME("00101 00010 ???????????? ????? ?????", disasm_load , ld.w );
-        __INSTPAT_NAME("00101 01000 ???????????? ????? ?????", disasm_load , ld.bu);
-        __INSTPAT_NAME("00101 01001 ???????????? ????? ?????", disasm_load , ld.hu);
-        __INSTPAT_NAME("00101 00100 ???????????? ????? ?????", disasm_store, st.b );
-        __INSTPAT_NAME("00101 00101 ???????????? ????? ?????", disasm_store, st.h );
-        __INSTPAT_NAME("00101 00110 ???????????? ????? ?????", disasm_store, st.w );
-
-        __INSTPAT_NAME("00000000001010100 ???????????????", disasm_15I, break  );
-        __INSTPAT_NAME("00000000001010110 ???????????????", disasm_15I, syscall);
-
-        #undef __INSTPAT_NONE
-        #undef __INSTPAT_NAME
+    TextWriter(char *buf, std::size_t cap) : buf(buf), cap(cap) {}
+
+    std::size_t length() const {
+        return len;
     }
 
-    void set_imm_hex(bool hex) {
-        hexImm = hex;
+    void put(char c) {
+        if (len + 1 < cap) {
+            buf[len] = c;
+        }
+        len++;
     }
 
-    void set_reg_alias(bool alias) {
-        regAlias = alias;
+    void put(const char *s, std::size_t n) {
+        if (len + n < cap) {
+            std::memcpy(buf + len, s, n);
+        } else if (len + 1 < cap) {
+            std::memcpy(buf + len, s, cap - 1 - len);
+        }
+        len += n;
     }
 
-    void set_reg_prefix(bool prefix) {
-        regPrefix = prefix;
+    void put(const char *s) {
+        put(s, std::strlen(s));
     }
 
-    void set_mode32(bool mode) {
-        mode32 = mode;
+    void put_hex(uint64_t n) {
+        char digits[16];
+        char *p = digits + sizeof(digits);
+        while (n >= 0x100) {
+            p -= 2;
+            std::memcpy(p, &digitPairs.hex[(n & 0xff) * 2], 2);
+            n >>= 8;
+        }
+        if (n >= 0x10) {
+            p -= 2;
+            std::memcpy(p, &digitPairs.hex[n * 2], 2);
+        } else {
+            *--p = digitPairs.hex[n * 2 + 1];
+        }
+        put(p, digits + sizeof(digits) - p);
     }
 
-    std::string fmt_gpr(unsigned int index) const {
-        static const char* gprAlias[] = {
+    void put_dec(uint64_t n) {
+        char digits[20];
+        char *p = digits + sizeof(digits);
+        while (n >= 100) {
+            p -= 2;
+            std::memcpy(p, &digitPairs.dec[(n % 100) * 2], 2);
+            n /= 100;
+        }
+        if (n >= 10) {
+            p -= 2;
+            std::memcpy(p, &digitPairs.dec[n * 2], 2);
+        } else {
+            *--p = '0' + n;
+        }
+        put(p, digits + sizeof(digits) - p);
+    }
+
+    // Hex with leading zeros up to min_digits, as used for listing addresses.
+    void put_hex(uint64_t n, unsigned int min_digits) {
+        unsigned int digits = 1;
+        for (uint64_t v = n >> 4; v != 0; v >>= 4) {
+            digits++;
+        }
+        for (; digits < min_digits; digits++) {
+            put('0');
+        }
+        put_hex(n);
+    }
+
+    void put_sdec(int64_t n) {
+        if (n < 0) {
+            put('-');
+            put_dec(0 - (uint64_t)n);
+        } else {
+            put_dec(n);
+        }
+    }
+
+    // Terminates the text and returns its full length.
+    std::size_t finish() {
+        if (cap != 0) {
+            buf[len < cap ? len : cap - 1] = '\0';
+        }
+        return len;
+    }
+};
+
+// Register files an operand can name.
+enum RegClass : uint8_t {
+    REG_GPR,
+    REG_FPR,
+    REG_VR,
+    REG_XR,
+    REG_FCC,
+    REG_FCSR,
+    REG_CLASSES,
+};
+
+// Register names for every class and regAlias/regPrefix combination, indexed by
+// class, then (regAlias << 1 | regPrefix), then register number.
+struct RegisterNameTable {
+    struct Name {
+        char text[7] = {};
+        uint8_t length = 0;
+    };
+    Name names[REG_CLASSES][4][32];
+
+    constexpr RegisterNameTable() : names() {
+        const char *gprAlias[32] = {
             "zero", "ra", "tp", "sp",
             "a0", "a1", "a2", "a3",
             "a4", "a5", "a6", "a7",
@@ -399,150 +684,1266 @@ public:
             "s1", "s2", "s3", "s4",
             "s5", "s6", "s7", "s8",
         };
-
-        if (index >= 32) {
-            return "";
-        }
-    
-        if (regAlias) {
-            if (regPrefix) {
-                return std::string("$") + gprAlias[index];
-            } else {
-                return gprAlias[index];
-            }
-        } else {
-            if (regPrefix) {
-                return "$r" + std::to_string(index);
-            } else {
-                return "r" + std::to_string(index);
+        // Numeric names; FPRs alias to fa0-fa7, ft0-ft15 and fs0-fs7, the
+        // other classes have no ABI names.
+        const char *prefix[REG_CLASSES] = {"r", "f", "vr", "xr", "fcc", "fcsr"};
+        for (int c = 0; c < REG_CLASSES; c++) {
+            for (int style = 0; style < 4; style++) {
+                for (int i = 0; i < 32; i++) {
+                    Name &n = names[c][style][i];
+                    int p = 0;
+                    auto put = [&n, &p](const char *s) {
+                        for (; *s; s++) {
+                            n.text[p++] = *s;
+                        }
+                    };
+                    auto put_num = [&n, &p](int v) {
+                        if (v >= 10) {
+                            n.text[p++] = '0' + v / 10;
+                        }
+                        n.text[p++] = '0' + v % 10;
+                    };
+                    if (style & 1) {
+                        put("$");
+                    }
+                    if ((style & 2) && c == REG_GPR) {
+                        put(gprAlias[i]);
+                    } else if ((style & 2) && c == REG_FPR) {
+                        put(i < 8 ? "fa" : i < 24 ? "ft" : "fs");
+                        put_num(i < 8 ? i : i < 24 ? i - 8 : i - 24);
+                    } else {
+                        put(prefix[c]);
+                        put_num(i);
+                    }
+                    n.length = p;
+                }
             }
         }
     }
+};
 
-    std::string fmt_gpr(const DecodeToken &token) const {
-        return fmt_gpr(token.num);
-    }
+// Maps code addresses to symbols so that PC-relative targets can be printed as
+// "<symbol+off>" after the address.
+class SymbolResolver {
+public:
+    virtual ~SymbolResolver() = default;
 
-    std::string fmt_imm(uint64_t imm, TokenType type) const {
-        switch (type) {
-            case UIMM32:
-                if (hexImm) {
-                    return "0x" + to_hex((uint32_t)imm);
-                } else {
-                    return std::to_string((uint32_t)imm);
-                }
-            case SIMM32:
-                if (hexImm) {
-                    int32_t imm32 = imm;
-                    if (imm32 < 0) return "-0x" + to_hex((uint32_t)-imm32);
-                    else return "0x" + to_hex((uint32_t)imm32);
-                } else {
-                    return std::to_string((int32_t)imm);
-                }
-            case UIMM64:
-                if (hexImm) {
-                    return "0x" + to_hex((uint64_t)imm);
-                } else {
-                    return std::to_string((uint64_t)imm);
-                }
-            case SIMM64:
-                if (hexImm) {
-                    int64_t imm64 = imm;
-                    if (imm64 < 0) return "-0x" + to_hex((uint64_t)-imm64);
-                    else return "0x" + to_hex((uint64_t)imm64);
-                } else {
-                    return std::to_string((int64_t)imm);
-                }
-            default:
-                return "";
-        }
-    }
+    // Returns the name of the symbol containing addr and sets off to addr's offset
+    // from it, or returns nullptr when no symbol applies.
+    virtual const char *resolve(uint64_t addr, uint64_t &off) const = 0;
+};
 
-    std::string fmt_imm(const DecodeToken &token) const {
-        return fmt_imm(token.num, token.type);
-    }
+// Output style of the formatting calls. A plain value: each call may pass its own,
+// so threads sharing one Disassembler can format differently without locking.
+struct FormatOptions {
+    bool hexImm = false;    // immediates and addresses in hex
+    bool regAlias = false;  // ABI register names (a0, sp, ...) instead of numbers
+    bool regPrefix = false; // '$' before register names
+    bool instAlias = true;  // ret and call instead of jirl and bl where they apply
+    bool mode32 = false;    // LA32: 32-bit addresses and offsets, no LA64-only instructions
+    bool reduced = false;   // with mode32, LA32R: only the LA32 Reduced instructions
+    // PC-relative targets are followed by "<symbol+off>" when the resolver knows
+    // them; nullptr turns this off.
+    const SymbolResolver *symbols = nullptr;
 
-    std::string fmt_pc(uint64_t pc, uint64_t off) const {
-        if (mode32) {
-            return fmt_imm((uint32_t)pc + (uint32_t)off, UIMM32);
-        } else {
-            return fmt_imm(pc + off, UIMM64);
-        }
+    // Index of the FormatPolicy matching these options.
+    unsigned int policy() const {
+        return hexImm | regAlias << 1 | regPrefix << 2 | mode32 << 3;
     }
 
-    std::string fmt_pc(uint64_t pc, const DecodeToken &token) const {
-        return fmt_pc(pc, token.num);
+    // Identifies the options that change decoded tokens or non-PC text.
+    uint32_t key() const {
+        return hexImm | regAlias << 1 | regPrefix << 2 | instAlias << 3 | mode32 << 4 | (mode32 && reduced) << 5;
     }
+};
 
-    std::string fmt_base_off(const DecodeToken &base, const DecodeToken &off) const {
-        if (mode32) {
-            return fmt_imm(off.num, SIMM32) + "(" + fmt_gpr(base) + ")";
-        }
-        else {
-            return fmt_imm(off.num, SIMM64) + "(" + fmt_gpr(base) + ")";
-        }
-    }
+// Format policies fix the FormatOptions bits that formatting branches on, so that a
+// formatter instantiated with one has no option checks left in its operand loop.
+// FormatPolicy<bits> has them as compile-time constants (bit 0 hexImm, 1 regAlias,
+// 2 regPrefix, 3 mode32); RuntimePolicy reads them from the options on every use.
+template<unsigned int Bits>
+struct FormatPolicy {
+    static constexpr bool hexImm(const FormatOptions &) { return Bits & 1; }
+    static constexpr bool regAlias(const FormatOptions &) { return Bits & 2; }
+    static constexpr bool regPrefix(const FormatOptions &) { return Bits & 4; }
+    static constexpr bool mode32(const FormatOptions &) { return Bits & 8; }
+};
 
-    std::string fmt_tokens(uint64_t pc, const DecodeTokenArray &tokens) const {
-        std::string result;
-        for (int i = 0; i < 4; i++) {
+struct RuntimePolicy {
+    static bool hexImm(const FormatOptions &opt) { return opt.hexImm; }
+    static bool regAlias(const FormatOptions &opt) { return opt.regAlias; }
+    static bool regPrefix(const FormatOptions &opt) { return opt.regPrefix; }
+    static bool mode32(const FormatOptions &opt) { return opt.mode32; }
+};
+
+class Disassembler {
+public:
+    enum TokenType {
+        NAME,   // str
+        RD,     // num
+        RJ,     // num
+        RK,     // num
+        UIMM32, // num
+        SIMM32, // num
+        UIMM64, // num
+        SIMM64, // num
+        PCOFF,  // num
+        BASEREG, // num
+        ADDROFF, // num
+        FREG,   // num
+        VREG,   // num
+        XREG,   // num
+        FCC,    // num
+        FCSR,   // num
+        END,
+    };
+    
+    struct DecodeToken {
+        TokenType type = END;
+        union {
+            const char *str;
+            uint64_t num;
+        };
+    };
+
+    // Most operands any instruction has; tokens are the name and then these.
+    static constexpr unsigned int MAX_OPERANDS = 4;
+    
+    struct DecodeTokenArray {
+        DecodeToken tokens[MAX_OPERANDS + 1];
+    };
+
+    // See token_formatter().
+    using TokenFormatter = std::size_t (*)(char *buf, std::size_t cap, uint64_t pc, const DecodeTokenArray &tokens, const FormatOptions &opt);
+
+    // Dense instruction IDs in table order, from la-instructions.def.
+    enum class Opcode : uint16_t {
+        #define __INSTPAT_NAME(id, pattern, format, name, isa) id,
+        #include "la-instructions.def"
+        #undef __INSTPAT_NAME
+        COUNT,
+        INVALID = COUNT,
+    };
+
+    // Operand layout of a table entry, from la-formats.def.
+    enum InstFormat : uint8_t {
+        #define __INSTFMT(name, ...) FMT_##name,
+        #include "la-formats.def"
+        #undef __INSTFMT
+        FMT_COUNT,
+    };
+
+    // The first level that has an instruction; each level includes the ones before
+    // it. LA32R is LA32 Reduced, the base integer and privileged subset of LA32
+    // that LA32R soft-cores implement.
+    enum IsaLevel : uint8_t {
+        LA32R,
+        LA32,
+        LA64,
+    };
+
+    enum class BranchKind : uint8_t {
+        NONE,
+        CONDITIONAL, // beq .. bgeu, beqz, bnez, bceqz, bcnez
+        JUMP,        // b
+        CALL,        // bl, or jirl linking through ra
+        INDIRECT,    // other jirl
+        RETURN,      // jirl zero, ra, offs
+    };
+
+    enum OperandAccess : uint8_t {
+        ACCESS_NONE = 0,
+        ACCESS_READ = 1,
+        ACCESS_WRITE = 2,
+        ACCESS_READWRITE = 3,
+    };
+
+    // One operand of a format. Its value is the field at [lo, lo + width), followed
+    // by the field at [lo2, lo2 + width2) when width2 is not zero, sign-extended for
+    // SIMM32, PCOFF and ADDROFF, shifted left by shift and offset by add.
+    struct OperandInfo {
+        TokenType type;
+        uint8_t lo;
+        uint8_t width;
+        uint8_t lo2;
+        uint8_t width2;
+        uint8_t shift;
+        uint8_t add;
+        OperandAccess access;
+    };
+
+    struct FormatInfo {
+        BranchKind branch;
+        uint8_t count;
+        OperandInfo operands[MAX_OPERANDS];
+    };
+
+    // Structured form of one instruction for emulators and analysis passes.
+    // Registers are reg_id()s, so plain GPR numbers for general registers. imm is
+    // the last immediate operand (the offset of memory accesses and branches) as
+    // the ISA applies it: signed fields sign-extended to 64 bits, unsigned ones
+    // zero-extended, and the shifted 20-bit upper immediates sign-extended from bit 31.
+    struct DecodedInst {
+        Opcode opcode = Opcode::INVALID;
+        InstFormat format = FMT_3R;
+        BranchKind branch = BranchKind::NONE;
+        uint8_t numReads = 0;
+        uint8_t numWrites = 0;
+        uint8_t reads[3] = {};
+        uint8_t writes[2] = {};
+        bool hasImm = false;
+        bool hasTarget = false; // target is the resolved address of a direct branch,
+                                // wrapped to 32 bits in mode32 as the listing shows it
+        int64_t imm = 0;
+        uint64_t target = 0;
+    };
+
+    // Eight-byte storage form of an instruction: the opcode plus its operand fields.
+    // Register fields at bits 4:0, 9:5 and 14:10 stay in place in regs, which for
+    // most formats reads as rd | rj << 5 | rk << 10 (unused fields are zero). The
+    // other operand fields are concatenated into imm in operand order, raw and
+    // unscaled (branch offsets are in instructions), and sign-extended when they
+    // form a single signed operand. An undecodable word keeps opcode INVALID and its
+    // bits in imm, so packing never loses information.
+    struct PackedInst {
+        Opcode opcode = Opcode::INVALID;
+        uint16_t regs = 0;
+        int32_t imm = 0;
+
+        unsigned int rd() const { return regs & 31; }
+        unsigned int rj() const { return regs >> 5 & 31; }
+        unsigned int rk() const { return regs >> 10 & 31; }
+    };
+
+    // Register identifier used by DecodedInst: class << 5 | number.
+    static constexpr uint8_t reg_id(RegClass regClass, unsigned int number) {
+        return regClass << 5 | (number & 31);
+    }
+
+    static constexpr RegClass reg_class(TokenType type) {
+        switch (type) {
+            case FREG: return REG_FPR;
+            case VREG: return REG_VR;
+            case XREG: return REG_XR;
+            case FCC: return REG_FCC;
+            case FCSR: return REG_FCSR;
+            default: return REG_GPR;
+        }
+    }
+
+    static constexpr bool is_register(TokenType type) {
+        return type == RD || type == RJ || type == RK || type == BASEREG || (type >= FREG && type <= FCSR);
+    }
+
+private:
+    // Options used by the overloads that do not take a FormatOptions.
+    FormatOptions defaults;
+
+    friend class DisassemblyCache;
+
+    struct DecoderEntry {
+        BitPat pattern;
+        InstFormat format;
+        const char *name;
+        IsaLevel isa;
+    };
+
+    // The instruction table is parsed at compile time and shared by every instance;
+    // the decode tree over it is built once per process on first use.
+    static const DecoderEntry instPatterns[];
+
+    static constexpr FormatInfo formatInfo[] = {
+        #define __OPERAND(type, lo, width, lo2, width2, shift, add, access) {type, lo, width, lo2, width2, shift, add, ACCESS_##access}
+        #define __OPERAND_NONE {END, 0, 0, 0, 0, 0, 0, ACCESS_NONE}
+        #define __INSTFMT(name, branch, count, op0, op1, op2, op3) {BranchKind::branch, count, {op0, op1, op2, op3}},
+        #include "la-formats.def"
+        #undef __INSTFMT
+        #undef __OPERAND_NONE
+        #undef __OPERAND
+    };
+
+    // Words classified per decode_batch() call on the batch paths.
+    static constexpr std::size_t BATCH_SIZE = 256;
+
+#ifdef LADISASSEMBLER_STATS
+    // Process-wide, like the decoders they measure.
+    struct Timing {
+        std::atomic<uint64_t> decoded{0};
+        std::atomic<uint64_t> decodeCycles{0};
+        std::atomic<uint64_t> formatted{0};
+        std::atomic<uint64_t> formatCycles{0};
+    };
+    static Timing timing;
+#endif
+
+    static bool decode(uint32_t inst, DecodeTokenArray &tokens, const FormatOptions &opt) {
+        __LADISASSEMBLER_STAT(StatTimer timer(timing.decodeCycles, timing.decoded);)
+        const Decoder<const DecoderEntry *> &table = decoder(opt);
+        int index = table.decode_index(inst);
+        if (index < 0) {
+            return false;
+        }
+        expand(inst, *table.entry(index), tokens, opt);
+        return true;
+    }
+
+    static Opcode opcode_of(const DecoderEntry &entry) {
+        return (Opcode)(&entry - instPatterns);
+    }
+
+    // Calls f(std::integral_constant<InstFormat, format>()), so that f can read the
+    // format's layout as a constant. A switch rather than an indirect call lets f
+    // inline into each case.
+    template<typename F>
+    static void with_format(InstFormat format, F &&f) {
+        switch (format) {
+            #define __INSTFMT(name, ...) case FMT_##name: f(std::integral_constant<InstFormat, FMT_##name>()); break;
+            #include "la-formats.def"
+            #undef __INSTFMT
+            default: break;
+        }
+    }
+
+    static constexpr bool is_signed(TokenType type) {
+        return type == SIMM32 || type == PCOFF || type == ADDROFF;
+    }
+
+    static constexpr uint32_t field_mask(unsigned int width) {
+        return width >= 32 ? ~0U : (1U << width) - 1;
+    }
+
+    // Raw bits of an operand's fields, concatenated, and their total width.
+    static uint32_t operand_bits(uint32_t inst, const OperandInfo &op, unsigned int &width) {
+        uint32_t bits = inst >> op.lo & field_mask(op.width);
+        width = op.width;
+        if (op.width2 != 0) {
+            bits = bits << op.width2 | (inst >> op.lo2 & field_mask(op.width2));
+            width += op.width2;
+        }
+        return bits;
+    }
+
+    static uint64_t operand_value(uint32_t inst, const OperandInfo &op) {
+        unsigned int width;
+        uint64_t value = operand_bits(inst, op, width);
+        if (is_signed(op.type)) {
+            value = (uint64_t)((int64_t)(value << (64 - width)) >> (64 - width));
+        }
+        return (value << op.shift) + op.add;
+    }
+
+    static void expand(uint32_t inst, const DecoderEntry &entry, DecodeTokenArray &tokens, const FormatOptions &opt) {
+        with_format(entry.format, [&](auto format) {
+            constexpr FormatInfo info = formatInfo[decltype(format)::value];
+            tokens.tokens[0].type = NAME;
+            tokens.tokens[0].str = entry.name;
+            for (unsigned int i = 0; i < info.count; i++) {
+                tokens.tokens[i + 1].type = info.operands[i].type;
+                tokens.tokens[i + 1].num = operand_value(inst, info.operands[i]);
+            }
+            if (info.count < MAX_OPERANDS) {
+                tokens.tokens[info.count + 1].type = END;
+            }
+        });
+        if (opt.instAlias) {
+            apply_alias(inst, entry, tokens);
+        }
+    }
+
+    // Instruction aliases: "ret" for jirl zero, ra, 0 and "call" for bl.
+    static void apply_alias(uint32_t inst, const DecoderEntry &entry, DecodeTokenArray &tokens) {
+        switch (opcode_of(entry)) {
+            case Opcode::JIRL:
+                if (inst == 0x4c000020) {
+                    tokens.tokens[0].str = "ret";
+                    tokens.tokens[1].type = END;
+                }
+                break;
+            case Opcode::BL:
+                tokens.tokens[0].str = "call";
+                break;
+            default:
+                break;
+        }
+    }
+
+    static void fill_decoded(uint32_t inst, uint64_t pc, const DecoderEntry &entry, bool mode32, DecodedInst &d) {
+        d = DecodedInst();
+        d.opcode = opcode_of(entry);
+        d.format = entry.format;
+        with_format(d.format, [&](auto format) {
+            constexpr FormatInfo info = formatInfo[decltype(format)::value];
+            d.branch = info.branch;
+            for (unsigned int i = 0; i < info.count; i++) {
+                const OperandInfo &op = info.operands[i];
+                uint64_t value = operand_value(inst, op);
+                if (is_register(op.type)) {
+                    uint8_t reg = reg_id(reg_class(op.type), value);
+                    if (op.access & ACCESS_READ) {
+                        d.reads[d.numReads++] = reg;
+                    }
+                    if (op.access & ACCESS_WRITE) {
+                        d.writes[d.numWrites++] = reg;
+                    }
+                } else {
+                    d.hasImm = true;
+                    d.imm = op.type == UIMM32 ? (int64_t)(int32_t)value : (int64_t)value;
+                    if (op.type == PCOFF) {
+                        d.hasTarget = true;
+                        d.target = mode32 ? (uint32_t)pc + (uint32_t)d.imm : pc + d.imm;
+                    }
+                }
+            }
+            if (info.branch == BranchKind::CALL) {
+                d.writes[d.numWrites++] = 1; // bl links through ra
+            }
+        });
+        if (d.opcode == Opcode::JIRL) {
+            unsigned int rd = inst & 31;
+            unsigned int rj = inst >> 5 & 31;
+            if (rd == 0 && rj == 1) {
+                d.branch = BranchKind::RETURN;
+            } else if (rd == 1) {
+                d.branch = BranchKind::CALL;
+            }
+        }
+    }
+
+    // Register fields kept in place in PackedInst::regs.
+    static constexpr bool packs_as_register(const OperandInfo &op) {
+        return is_register(op.type) && op.width2 == 0 && op.width <= 5 && (op.lo == 0 || op.lo == 5 || op.lo == 10);
+    }
+
+    static void fill_packed(uint32_t inst, const DecoderEntry &entry, PackedInst &p) {
+        p.opcode = opcode_of(entry);
+        with_format(entry.format, [&](auto format) {
+            constexpr FormatInfo info = formatInfo[decltype(format)::value];
+            uint32_t regs = 0;
+            uint32_t imm = 0;
+            unsigned int immWidth = 0;
+            unsigned int immOperands = 0;
+            bool immSigned = false;
+            for (unsigned int i = 0; i < info.count; i++) {
+                const OperandInfo &op = info.operands[i];
+                if (packs_as_register(op)) {
+                    regs |= inst & field_mask(op.width) << op.lo;
+                } else {
+                    unsigned int width;
+                    uint32_t bits = operand_bits(inst, op, width);
+                    imm = immWidth == 0 ? bits : imm << width | bits;
+                    immWidth += width;
+                    immOperands++;
+                    immSigned = is_signed(op.type);
+                }
+            }
+            p.regs = regs;
+            if (immOperands == 1 && immSigned && immWidth < 32) {
+                p.imm = (int32_t)(imm << (32 - immWidth)) >> (32 - immWidth);
+            } else {
+                p.imm = (int32_t)imm;
+            }
+        });
+    }
+
+    static uint32_t unpack_fields(const DecoderEntry &entry, const PackedInst &p) {
+        uint32_t inst = entry.pattern.get_bits() & entry.pattern.get_mask();
+        with_format(entry.format, [&](auto format) {
+            constexpr FormatInfo info = formatInfo[decltype(format)::value];
+            uint32_t imm = (uint32_t)p.imm;
+            for (unsigned int i = info.count; i-- > 0; ) {
+                const OperandInfo &op = info.operands[i];
+                if (packs_as_register(op)) {
+                    inst |= p.regs & field_mask(op.width) << op.lo;
+                } else {
+                    if (op.width2 != 0) {
+                        inst |= (imm & field_mask(op.width2)) << op.lo2;
+                        imm >>= op.width2;
+                    }
+                    inst |= (imm & field_mask(op.width)) << op.lo;
+                    imm = op.width >= 32 ? 0 : imm >> op.width;
+                }
+            }
+        });
+        return inst;
+    }
+
+private:
+    static const RegisterNameTable registerNames;
+
+    template<typename P>
+    static void put_reg(TextWriter &w, RegClass regClass, unsigned int index, const FormatOptions &opt) {
+        if (index >= 32) {
+            return;
+        }
+        const RegisterNameTable::Name &name = registerNames.names[regClass][P::regAlias(opt) << 1 | P::regPrefix(opt)][index];
+        w.put(name.text, name.length);
+    }
+
+    template<typename P>
+    static void put_gpr(TextWriter &w, unsigned int index, const FormatOptions &opt) {
+        put_reg<P>(w, REG_GPR, index, opt);
+    }
+
+    template<typename P>
+    static void put_imm(TextWriter &w, uint64_t imm, TokenType type, const FormatOptions &opt) {
+        switch (type) {
+            case UIMM32:
+                if (P::hexImm(opt)) {
+                    w.put("0x", 2);
+                    w.put_hex((uint32_t)imm);
+                } else {
+                    w.put_dec((uint32_t)imm);
+                }
+                break;
+            case SIMM32:
+                if (P::hexImm(opt)) {
+                    int32_t imm32 = imm;
+                    if (imm32 < 0) {
+                        w.put("-0x", 3);
+                        w.put_hex(0U - (uint32_t)imm32);
+                    } else {
+                        w.put("0x", 2);
+                        w.put_hex((uint32_t)imm32);
+                    }
+                } else {
+                    w.put_sdec((int32_t)imm);
+                }
+                break;
+            case UIMM64:
+                if (P::hexImm(opt)) {
+                    w.put("0x", 2);
+                    w.put_hex(imm);
+                } else {
+                    w.put_dec(imm);
+                }
+                break;
+            case SIMM64:
+                if (P::hexImm(opt)) {
+                    int64_t imm64 = imm;
+                    if (imm64 < 0) {
+                        w.put("-0x", 3);
+                        w.put_hex(0 - (uint64_t)imm64);
+                    } else {
+                        w.put("0x", 2);
+                        w.put_hex(imm64);
+                    }
+                } else {
+                    w.put_sdec((int64_t)imm);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    template<typename P>
+    static void put_pc(TextWriter &w, uint64_t pc, uint64_t off, const FormatOptions &opt) {
+        uint64_t target;
+        if (P::mode32(opt)) {
+            target = (uint32_t)pc + (uint32_t)off;
+            put_imm<P>(w, target, UIMM32, opt);
+        } else {
+            target = pc + off;
+            put_imm<P>(w, target, UIMM64, opt);
+        }
+        if (opt.symbols) {
+            uint64_t symOff = 0;
+            const char *name = opt.symbols->resolve(target, symOff);
+            if (name) {
+                w.put(" <", 2);
+                w.put(name);
+                if (symOff != 0) {
+                    w.put("+0x", 3);
+                    w.put_hex(symOff);
+                }
+                w.put('>');
+            }
+        }
+    }
+
+    template<typename P>
+    static void put_base_off(TextWriter &w, const DecodeToken &base, const DecodeToken &off, const FormatOptions &opt) {
+        put_imm<P>(w, off.num, P::mode32(opt) ? SIMM32 : SIMM64, opt);
+        w.put('(');
+        put_gpr<P>(w, base.num, opt);
+        w.put(')');
+    }
+
+    // pcSpan, if given, receives where the PC-relative operand starts and ends in the text.
+    template<typename P>
+    static void put_tokens(TextWriter &w, uint64_t pc, const DecodeTokenArray &tokens, const FormatOptions &opt,
+            std::pair<std::size_t, std::size_t> *pcSpan = nullptr) {
+        const int count = MAX_OPERANDS + 1;
+        for (int i = 0; i < count; i++) {
             if (tokens.tokens[i].type == END) {
                 break;
             }
 
             switch (tokens.tokens[i].type) {
                 case NAME:
-                    result += tokens.tokens[i].str;
+                    w.put(tokens.tokens[i].str);
                     break;
                 case RD:
                 case RJ:
                 case RK:
-                    result += fmt_gpr(tokens.tokens[i]);
+                    put_gpr<P>(w, tokens.tokens[i].num, opt);
+                    break;
+                case FREG:
+                case VREG:
+                case XREG:
+                case FCC:
+                case FCSR:
+                    put_reg<P>(w, reg_class(tokens.tokens[i].type), tokens.tokens[i].num, opt);
                     break;
                 case UIMM32:
                 case SIMM32:
                 case UIMM64:
                 case SIMM64:
-                    result += fmt_imm(tokens.tokens[i]);
+                    put_imm<P>(w, tokens.tokens[i].num, tokens.tokens[i].type, opt);
                     break;
                 case PCOFF:
-                    result += fmt_pc(pc, tokens.tokens[i]);
+                    if (pcSpan) {
+                        pcSpan->first = w.length();
+                    }
+                    put_pc<P>(w, pc, tokens.tokens[i].num, opt);
+                    if (pcSpan) {
+                        pcSpan->second = w.length();
+                    }
                     break;
                 case BASEREG:
-                    if (i != 3 && tokens.tokens[i + 1].type == ADDROFF) {
-                        result += fmt_base_off(tokens.tokens[i], tokens.tokens[i + 1]);
+                    if (i + 1 < count && tokens.tokens[i + 1].type == ADDROFF) {
+                        put_base_off<P>(w, tokens.tokens[i], tokens.tokens[i + 1], opt);
                         i++;
                     } else {
-                        result += fmt_gpr(tokens.tokens[i]);
+                        put_gpr<P>(w, tokens.tokens[i].num, opt);
                     }
                 default:
                     break;
             }
-            if (tokens.tokens[i].type != NAME && i < 3 && tokens.tokens[i + 1].type != END) {
-                result += ",";
+            if (i + 1 == count || tokens.tokens[i + 1].type == END) {
+                break;
             }
-            if (i < 3) {
-                result += " ";
+            if (tokens.tokens[i].type != NAME) {
+                w.put(',');
             }
+            w.put(' ');
+        }
+    }
+
+    using TokenWriter = void (*)(TextWriter &w, uint64_t pc, const DecodeTokenArray &tokens, const FormatOptions &opt,
+        std::pair<std::size_t, std::size_t> *pcSpan);
+
+    template<std::size_t... Bits>
+    static constexpr std::array<TokenWriter, sizeof...(Bits)> make_token_writers(std::index_sequence<Bits...>) {
+        return {{&put_tokens<FormatPolicy<Bits>>...}};
+    }
+
+    template<std::size_t... Bits>
+    static constexpr std::array<TokenFormatter, sizeof...(Bits)> make_token_formatters(std::index_sequence<Bits...>) {
+        return {{&format_tokens<FormatPolicy<Bits>>...}};
+    }
+
+    // put_tokens() specialized for each of the 16 FormatPolicy combinations.
+    static const std::array<TokenWriter, 16> tokenWriters;
+    static const std::array<TokenFormatter, 16> tokenFormatters;
+
+    template<typename P>
+    static std::size_t format_tokens(char *buf, std::size_t cap, uint64_t pc, const DecodeTokenArray &tokens, const FormatOptions &opt) {
+        TextWriter w(buf, cap);
+        put_tokens<P>(w, pc, tokens, opt);
+        return w.finish();
+    }
+
+    static TokenWriter token_writer(const FormatOptions &opt) {
+        return tokenWriters[opt.policy()];
+    }
+
+    // Calls put(FormatPolicy<opt.policy()>()), for the entry points that format a
+    // single operand and are not worth a table of their own.
+    template<typename F, std::size_t... Bits>
+    static void with_policy(const FormatOptions &opt, F &&put, std::index_sequence<Bits...>) {
+        unsigned int policy = opt.policy();
+        ((policy == Bits ? put(FormatPolicy<Bits>()) : void()), ...);
+    }
+
+    template<typename F>
+    static void with_policy(const FormatOptions &opt, F &&put) {
+        with_policy(opt, put, std::make_index_sequence<16>());
+    }
+
+    static void write_tokens(TextWriter &w, uint64_t pc, const DecodeTokenArray &tokens, const FormatOptions &opt,
+            std::pair<std::size_t, std::size_t> *pcSpan = nullptr) {
+        __LADISASSEMBLER_STAT(StatTimer timer(timing.formatCycles, timing.formatted);)
+        token_writer(opt)(w, pc, tokens, opt, pcSpan);
+    }
+
+    static void write_pc(TextWriter &w, uint64_t pc, uint64_t off, const FormatOptions &opt) {
+        with_policy(opt, [&](auto policy) { put_pc<decltype(policy)>(w, pc, off, opt); });
+    }
+
+    static void put_inst(TextWriter &w, uint32_t inst, uint64_t pc, const FormatOptions &opt) {
+        DecodeTokenArray tokens;
+        if (decode(inst, tokens, opt)) {
+            write_tokens(w, pc, tokens, opt);
+        }
+    }
+
+    // Runs put_* into a stack buffer and copies the text out, so the std::string
+    // API below produces exactly what the buffer API does.
+    template<typename F>
+    static std::string to_string(F &&put) {
+        char text[128];
+        TextWriter w(text, sizeof(text));
+        put(w);
+        if (w.length() < sizeof(text)) {
+            return std::string(text, w.length());
         }
+        std::string result(w.length() + 1, '\0');
+        TextWriter big(&result[0], result.size());
+        put(big);
+        result.resize(w.length());
         return result;
     }
 
+public:
+    Disassembler() = default;
+
+    // Process-wide decoders over the instruction table, one per ISA level, built on
+    // first use: the full LA64 table, the instructions LA32 has, or only those of
+    // LA32 Reduced, so that narrower targets reject the other encodings with no
+    // check on the lookup path. Pattern indices are positions in the decoder, not
+    // opcodes; entry(index) gives the table entry.
+    static const Decoder<const DecoderEntry *> &decoder(IsaLevel level);
+
+    static const Decoder<const DecoderEntry *> &decoder(bool mode32 = false) {
+        return decoder(mode32 ? LA32 : LA64);
+    }
+
+    // The table the options decode with.
+    static const Decoder<const DecoderEntry *> &decoder(const FormatOptions &opt) {
+        return decoder(isa_level(opt));
+    }
+
+    static IsaLevel isa_level(const FormatOptions &opt) {
+        return !opt.mode32 ? LA64 : opt.reduced ? LA32R : LA32;
+    }
+
+    // Setters change the options used by the overloads without a FormatOptions
+    // argument. They are not synchronized: threads sharing a Disassembler should pass
+    // their options per call instead, which leaves the instance untouched.
+    void set_imm_hex(bool hex) {
+        defaults.hexImm = hex;
+    }
+
+    void set_reg_alias(bool alias) {
+        defaults.regAlias = alias;
+    }
+
+    void set_reg_prefix(bool prefix) {
+        defaults.regPrefix = prefix;
+    }
+
+    // LA32 mode decodes with the LA32 table, so LA64-only encodings are invalid,
+    // and prints 32-bit addresses.
+    void set_mode32(bool mode) {
+        defaults.mode32 = mode;
+    }
+
+    // In LA32 mode, decodes with the LA32 Reduced table instead, for LA32R cores.
+    void set_reduced(bool reduced) {
+        defaults.reduced = reduced;
+    }
+
+    // The resolver must outlive the disassembler; nullptr turns this off.
+    void set_symbol_resolver(const SymbolResolver *resolver) {
+        defaults.symbols = resolver;
+    }
+
+    void set_options(const FormatOptions &opt) {
+        defaults = opt;
+    }
+
+    const FormatOptions &options() const {
+        return defaults;
+    }
+
+    uint32_t options_key() const {
+        return defaults.key();
+    }
+
+    std::string fmt_gpr(unsigned int index, const FormatOptions &opt) const {
+        return to_string([&](TextWriter &w) {
+            with_policy(opt, [&](auto policy) { put_gpr<decltype(policy)>(w, index, opt); });
+        });
+    }
+
+    std::string fmt_gpr(unsigned int index) const {
+        return fmt_gpr(index, defaults);
+    }
+
+    std::string fmt_gpr(const DecodeToken &token) const {
+        return fmt_gpr(token.num, defaults);
+    }
+
+    std::string fmt_imm(uint64_t imm, TokenType type, const FormatOptions &opt) const {
+        return to_string([&](TextWriter &w) {
+            with_policy(opt, [&](auto policy) { put_imm<decltype(policy)>(w, imm, type, opt); });
+        });
+    }
+
+    std::string fmt_imm(uint64_t imm, TokenType type) const {
+        return fmt_imm(imm, type, defaults);
+    }
+
+    std::string fmt_imm(const DecodeToken &token) const {
+        return fmt_imm(token.num, token.type, defaults);
+    }
+
+    std::string fmt_pc(uint64_t pc, uint64_t off, const FormatOptions &opt) const {
+        return to_string([&](TextWriter &w) { write_pc(w, pc, off, opt); });
+    }
+
+    std::string fmt_pc(uint64_t pc, uint64_t off) const {
+        return fmt_pc(pc, off, defaults);
+    }
+
+    std::string fmt_pc(uint64_t pc, const DecodeToken &token) const {
+        return fmt_pc(pc, token.num, defaults);
+    }
+
+    std::string fmt_base_off(const DecodeToken &base, const DecodeToken &off, const FormatOptions &opt) const {
+        return to_string([&](TextWriter &w) {
+            with_policy(opt, [&](auto policy) { put_base_off<decltype(policy)>(w, base, off, opt); });
+        });
+    }
+
+    std::string fmt_base_off(const DecodeToken &base, const DecodeToken &off) const {
+        return fmt_base_off(base, off, defaults);
+    }
+
+    std::string fmt_tokens(uint64_t pc, const DecodeTokenArray &tokens, const FormatOptions &opt) const {
+        return to_string([&](TextWriter &w) { write_tokens(w, pc, tokens, opt); });
+    }
+
+    std::string fmt_tokens(uint64_t pc, const DecodeTokenArray &tokens) const {
+        return fmt_tokens(pc, tokens, defaults);
+    }
+
+    // Formats tokens into buf without allocating. Writes at most cap - 1 characters plus
+    // a terminating NUL and returns the full text length; a result >= cap means truncation.
+    std::size_t fmt_tokens_to(char *buf, std::size_t cap, uint64_t pc, const DecodeTokenArray &tokens, const FormatOptions &opt) const {
+        TextWriter w(buf, cap);
+        write_tokens(w, pc, tokens, opt);
+        return w.finish();
+    }
+
+    std::size_t fmt_tokens_to(char *buf, std::size_t cap, uint64_t pc, const DecodeTokenArray &tokens) const {
+        return fmt_tokens_to(buf, cap, pc, tokens, defaults);
+    }
+
+    // fmt_tokens_to() as a plain function compiled for one format policy. Callers that
+    // format many instructions with the same options look this up once and call it
+    // directly; opt must match the options it was looked up with (only symbols is
+    // still read from it). specialized = false gives the generic instantiation that
+    // checks every option per operand, for comparison.
+    static TokenFormatter token_formatter(const FormatOptions &opt, bool specialized = true) {
+        return specialized ? tokenFormatters[opt.policy()] : &format_tokens<RuntimePolicy>;
+    }
+
+    // Only instAlias, mode32 and reduced affect tokens; the other options apply when
+    // they are formatted.
+    bool disassemble_to_tokens(uint32_t inst, DecodeTokenArray &tokens, const FormatOptions &opt) const {
+        return decode(inst, tokens, opt);
+    }
+
     bool disassemble_to_tokens(uint32_t inst, DecodeTokenArray &tokens) const {
-        return decode(inst, tokens);
+        return decode(inst, tokens, defaults);
     }
-    
-    std::string disassemble(uint32_t inst, uint64_t pc) {
+
+    // Decodes n words into tokens[0..n). Invalid words get tokens whose first type is END.
+    // Returns the number of valid words.
+    std::size_t disassemble_to_tokens(const uint32_t *words, std::size_t n, DecodeTokenArray *tokens, const FormatOptions &opt) const {
+        const Decoder<const DecoderEntry *> &table = decoder(opt);
+        int32_t indices[BATCH_SIZE];
+        std::size_t valid = 0;
+        for (std::size_t at = 0; at < n; at += BATCH_SIZE) {
+            std::size_t m = std::min(BATCH_SIZE, n - at);
+            __LADISASSEMBLER_STAT(StatTimer timer(timing.decodeCycles, timing.decoded, m);)
+            table.decode_batch(words + at, m, indices);
+            for (std::size_t i = 0; i < m; i++) {
+                tokens[at + i] = DecodeTokenArray();
+                if (indices[i] >= 0) {
+                    expand(words[at + i], *table.entry(indices[i]), tokens[at + i], opt);
+                    valid++;
+                }
+            }
+        }
+        return valid;
+    }
+
+    std::size_t disassemble_to_tokens(const uint32_t *words, std::size_t n, DecodeTokenArray *tokens) const {
+        return disassemble_to_tokens(words, n, tokens, defaults);
+    }
+
+    // Decodes inst at pc into structured form, with no formatting. Returns false for
+    // words that match no pattern. Of the options only mode32 and reduced apply.
+    bool decode_inst(uint32_t inst, uint64_t pc, DecodedInst &out, const FormatOptions &opt) const {
+        __LADISASSEMBLER_STAT(StatTimer timer(timing.decodeCycles, timing.decoded);)
+        const Decoder<const DecoderEntry *> &table = decoder(opt);
+        int index = table.decode_index(inst);
+        if (index < 0) {
+            out = DecodedInst();
+            return false;
+        }
+        fill_decoded(inst, pc, *table.entry(index), opt.mode32, out);
+        return true;
+    }
+
+    bool decode_inst(uint32_t inst, uint64_t pc, DecodedInst &out) const {
+        return decode_inst(inst, pc, out, defaults);
+    }
+
+    // Batch form of decode_inst() for n consecutive words from base_pc; invalid words
+    // get opcode INVALID. Returns the number of valid words.
+    std::size_t decode_block(const uint32_t *words, std::size_t n, uint64_t base_pc, DecodedInst *out, const FormatOptions &opt) const {
+        const Decoder<const DecoderEntry *> &table = decoder(opt);
+        int32_t indices[BATCH_SIZE];
+        std::size_t valid = 0;
+        for (std::size_t at = 0; at < n; at += BATCH_SIZE) {
+            std::size_t m = std::min(BATCH_SIZE, n - at);
+            __LADISASSEMBLER_STAT(StatTimer timer(timing.decodeCycles, timing.decoded, m);)
+            table.decode_batch(words + at, m, indices);
+            for (std::size_t i = 0; i < m; i++) {
+                if (indices[i] >= 0) {
+                    fill_decoded(words[at + i], base_pc + 4 * (at + i), *table.entry(indices[i]), opt.mode32, out[at + i]);
+                    valid++;
+                } else {
+                    out[at + i] = DecodedInst();
+                }
+            }
+        }
+        return valid;
+    }
+
+    std::size_t decode_block(const uint32_t *words, std::size_t n, uint64_t base_pc, DecodedInst *out) const {
+        return decode_block(words, n, base_pc, out, defaults);
+    }
+
+    // Packs inst into its storage form. Returns false, with opcode INVALID and the
+    // word kept in imm, if it matches no pattern. Packing uses the full LA64 table;
+    // mode32 and reduced are applied when a packed instruction is expanded.
+    static bool pack(uint32_t inst, PackedInst &out) {
+        const Decoder<const DecoderEntry *> &table = decoder();
+        int index = table.decode_index(inst);
+        if (index < 0) {
+            out = PackedInst();
+            out.imm = (int32_t)inst;
+            return false;
+        }
+        fill_packed(inst, *table.entry(index), out);
+        return true;
+    }
+
+    // Batch form of pack() over n words. Returns the number of valid words.
+    static std::size_t pack_block(const uint32_t *words, std::size_t n, PackedInst *out) {
+        const Decoder<const DecoderEntry *> &table = decoder();
+        int32_t indices[BATCH_SIZE];
+        std::size_t valid = 0;
+        for (std::size_t at = 0; at < n; at += BATCH_SIZE) {
+            std::size_t m = std::min(BATCH_SIZE, n - at);
+            table.decode_batch(words + at, m, indices);
+            for (std::size_t i = 0; i < m; i++) {
+                if (indices[i] >= 0) {
+                    fill_packed(words[at + i], *table.entry(indices[i]), out[at + i]);
+                    valid++;
+                } else {
+                    out[at + i] = PackedInst();
+                    out[at + i].imm = (int32_t)words[at + i];
+                }
+            }
+        }
+        return valid;
+    }
+
+    // Re-encodes a packed instruction into the word it was packed from.
+    static uint32_t unpack(const PackedInst &p) {
+        if (p.opcode >= Opcode::COUNT) {
+            return (uint32_t)p.imm;
+        }
+        return unpack_fields(instPatterns[(std::size_t)p.opcode], p);
+    }
+
+    // Expands a packed instruction to the tokens disassemble_to_tokens() gives for
+    // the original word, without walking the decode tree.
+    bool disassemble_to_tokens(const PackedInst &p, DecodeTokenArray &tokens, const FormatOptions &opt) const {
+        if (p.opcode >= Opcode::COUNT || isa_level(p.opcode) > isa_level(opt)) {
+            return false;
+        }
+        expand(unpack(p), instPatterns[(std::size_t)p.opcode], tokens, opt);
+        return true;
+    }
+
+    bool disassemble_to_tokens(const PackedInst &p, DecodeTokenArray &tokens) const {
+        return disassemble_to_tokens(p, tokens, defaults);
+    }
+
+    // Encoding pattern of an opcode: its fixed bits and which bits are fixed.
+    static BitPat pattern(Opcode opcode) {
+        return instPatterns[(std::size_t)opcode].pattern;
+    }
+
+    // Operand layout of a format, as decode_inst() and the formatters read it.
+    static const FormatInfo &format_info(InstFormat format) {
+        return formatInfo[format];
+    }
+
+    static InstFormat format_of(Opcode opcode) {
+        return opcode >= Opcode::COUNT ? FMT_COUNT : instPatterns[(std::size_t)opcode].format;
+    }
+
+    // LA64 for instructions that do not exist on LA32, LA32R for those LA32 Reduced
+    // keeps.
+    static IsaLevel isa_level(Opcode opcode) {
+        return opcode >= Opcode::COUNT ? LA64 : instPatterns[(std::size_t)opcode].isa;
+    }
+
+    // Canonical mnemonic of an opcode, without instruction aliases.
+    static const char *mnemonic(Opcode opcode) {
+        if (opcode >= Opcode::COUNT) {
+            return "";
+        }
+        return instPatterns[(std::size_t)opcode].name;
+    }
+
+    // Process-wide counters, for tuning the table to a workload. Only collected when
+    // built with LADISASSEMBLER_STATS; otherwise everything reads zero.
+    struct Stats {
+        std::vector<uint64_t> hits;  // matches per Opcode, both tables
+        uint64_t misses = 0;         // words that matched no pattern
+        // Matches by how many decode tree leaf candidates were tried before the hit.
+        uint64_t positions[Decoder<const DecoderEntry *>::STAT_POSITIONS] = {};
+        uint64_t decoded = 0;        // words looked up on the timed paths
+        uint64_t decodeCycles = 0;   // time stamp counter ticks, or ns without one
+        uint64_t formatted = 0;      // instructions formatted
+        uint64_t formatCycles = 0;
+    };
+
+    static constexpr bool stats_enabled() {
+#ifdef LADISASSEMBLER_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static Stats stats() {
+        Stats s;
+        s.hits.assign((std::size_t)Opcode::COUNT, 0);
+        for (IsaLevel level : {LA32R, LA32, LA64}) {
+            const Decoder<const DecoderEntry *> &table = decoder(level);
+            typename Decoder<const DecoderEntry *>::Stats t = table.stats();
+            for (std::size_t i = 0; i < t.hits.size(); i++) {
+                s.hits[(std::size_t)opcode_of(*table.entry(i))] += t.hits[i];
+            }
+            s.misses += t.misses;
+            for (unsigned int i = 0; i < Decoder<const DecoderEntry *>::STAT_POSITIONS; i++) {
+                s.positions[i] += t.positions[i];
+            }
+        }
+#ifdef LADISASSEMBLER_STATS
+        s.decoded = timing.decoded.load(std::memory_order_relaxed);
+        s.decodeCycles = timing.decodeCycles.load(std::memory_order_relaxed);
+        s.formatted = timing.formatted.load(std::memory_order_relaxed);
+        s.formatCycles = timing.formatCycles.load(std::memory_order_relaxed);
+#endif
+        return s;
+    }
+
+    static void reset_stats() {
+        for (IsaLevel level : {LA32R, LA32, LA64}) {
+            decoder(level).reset_stats();
+        }
+#ifdef LADISASSEMBLER_STATS
+        timing.decoded.store(0, std::memory_order_relaxed);
+        timing.decodeCycles.store(0, std::memory_order_relaxed);
+        timing.formatted.store(0, std::memory_order_relaxed);
+        timing.formatCycles.store(0, std::memory_order_relaxed);
+#endif
+    }
+
+    // Writes s as a short report: totals, timing, the match position histogram and
+    // the top most frequent opcodes.
+    static void dump_stats(std::ostream &out, const Stats &s, std::size_t top = 20) {
+        if (!stats_enabled()) {
+            out << "stats: not collected (build with LADISASSEMBLER_STATS)" << std::endl;
+            return;
+        }
+        uint64_t matched = 0;
+        for (uint64_t h : s.hits) {
+            matched += h;
+        }
+        out << "stats: " << matched << " matched, " << s.misses << " missed" << std::endl;
+        out << "  decode: " << s.decoded << " words, " << s.decodeCycles << " cycles";
+        if (s.decoded) {
+            out << " (" << (double)s.decodeCycles / s.decoded << " per word)";
+        }
+        out << std::endl << "  format: " << s.formatted << " instructions, " << s.formatCycles << " cycles";
+        if (s.formatted) {
+            out << " (" << (double)s.formatCycles / s.formatted << " per instruction)";
+        }
+        out << std::endl << "  match position:";
+        for (unsigned int i = 0; i < Decoder<const DecoderEntry *>::STAT_POSITIONS; i++) {
+            out << " " << s.positions[i];
+        }
+        out << std::endl;
+        std::vector<std::size_t> order;
+        for (std::size_t i = 0; i < s.hits.size(); i++) {
+            if (s.hits[i]) {
+                order.push_back(i);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return s.hits[a] > s.hits[b]; });
+        for (std::size_t i = 0; i < std::min(top, order.size()); i++) {
+            out << "  " << instPatterns[order[i]].name << " " << s.hits[order[i]] << std::endl;
+        }
+    }
+
+    std::string disassemble(uint32_t inst, uint64_t pc, const FormatOptions &opt) const {
         DecodeTokenArray tokens;
-        bool s = disassemble_to_tokens(inst, tokens);
+        bool s = disassemble_to_tokens(inst, tokens, opt);
         if (!s) {
             return "";
         }
 
-        return fmt_tokens(pc, tokens);
+        return fmt_tokens(pc, tokens, opt);
+    }
+
+    std::string disassemble(uint32_t inst, uint64_t pc) const {
+        return disassemble(inst, pc, defaults);
+    }
+
+    // Allocation-free counterpart of disassemble() with the same text; an invalid
+    // instruction yields an empty string and returns 0.
+    std::size_t disassemble_to(char *buf, std::size_t cap, uint32_t inst, uint64_t pc, const FormatOptions &opt) const {
+        TextWriter w(buf, cap);
+        put_inst(w, inst, pc, opt);
+        return w.finish();
+    }
+
+    std::size_t disassemble_to(char *buf, std::size_t cap, uint32_t inst, uint64_t pc) const {
+        return disassemble_to(buf, cap, inst, pc, defaults);
+    }
+
+    // Disassembles n consecutive words starting at base_pc in one call. For each word
+    // sink(pc, inst, text, length) is invoked; invalid words get an empty text.
+    template<typename Sink>
+    void disassemble_block(const uint32_t *words, std::size_t n, uint64_t base_pc, Sink &sink, const FormatOptions &opt) const {
+        char text[128];
+        int32_t indices[BATCH_SIZE];
+        uint64_t pc = base_pc;
+        TokenWriter write = token_writer(opt);
+        const Decoder<const DecoderEntry *> &table = decoder(opt);
+        for (std::size_t at = 0; at < n; at += BATCH_SIZE) {
+            std::size_t m = std::min(BATCH_SIZE, n - at);
+            {
+                __LADISASSEMBLER_STAT(StatTimer timer(timing.decodeCycles, timing.decoded, m);)
+                table.decode_batch(words + at, m, indices);
+            }
+            for (std::size_t i = 0; i < m; i++, pc += 4) {
+                uint32_t inst = words[at + i];
+                DecodeTokenArray tokens;
+                TextWriter w(text, sizeof(text));
+                if (indices[i] >= 0) {
+                    {
+                        __LADISASSEMBLER_STAT(StatTimer timer(timing.decodeCycles, timing.decoded, 0);)
+                        expand(inst, *table.entry(indices[i]), tokens, opt);
+                    }
+                    __LADISASSEMBLER_STAT(StatTimer timer(timing.formatCycles, timing.formatted);)
+                    write(w, pc, tokens, opt, nullptr);
+                }
+                std::size_t length = w.finish();
+                if (length < sizeof(text)) {
+                    sink(pc, inst, (const char *)text, length);
+                } else {
+                    // Longer than the stack buffer (a long symbol name): format the
+                    // same tokens once more into a string of the measured size.
+                    std::string s(length + 1, '\0');
+                    TextWriter big(&s[0], s.size());
+                    write(big, pc, tokens, opt, nullptr);
+                    s.resize(big.finish());
+                    sink(pc, inst, s.c_str(), s.size());
+                }
+            }
+        }
+    }
+
+    template<typename Sink>
+    void disassemble_block(const uint32_t *words, std::size_t n, uint64_t base_pc, Sink &sink) const {
+        disassemble_block(words, n, base_pc, sink, defaults);
+    }
+
+    // Appends one line per word to out; an invalid word gives an empty line.
+    // Reusing out across calls keeps this allocation-free once it has grown.
+    void disassemble_block(const uint32_t *words, std::size_t n, uint64_t base_pc, std::string &out, const FormatOptions &opt) const {
+        auto append = [&out](uint64_t, uint32_t, const char *text, std::size_t length) {
+            out.append(text, length);
+            out.push_back('\n');
+        };
+        disassemble_block(words, n, base_pc, append, opt);
+    }
+
+    void disassemble_block(const uint32_t *words, std::size_t n, uint64_t base_pc, std::string &out) const {
+        disassemble_block(words, n, base_pc, out, defaults);
     }
 };
 
+inline constexpr RegisterNameTable Disassembler::registerNames{};
+
+#ifdef LADISASSEMBLER_STATS
+inline Disassembler::Timing Disassembler::timing;
+#endif
+
+#define __INSTPAT_NAME(id, pattern, format, name, isa) {BitPat(pattern), Disassembler::FMT_##format, #name, Disassembler::isa},
+
+inline constexpr Disassembler::DecoderEntry Disassembler::instPatterns[] = {
+#include "la-instructions.def"
+};
+
+#undef __INSTPAT_NAME
+
+inline constexpr std::array<Disassembler::TokenWriter, 16> Disassembler::tokenWriters =
+    Disassembler::make_token_writers(std::make_index_sequence<16>());
+
+inline constexpr std::array<Disassembler::TokenFormatter, 16> Disassembler::tokenFormatters =
+    Disassembler::make_token_formatters(std::make_index_sequence<16>());
+
+static_assert(sizeof(Disassembler::PackedInst) == 8, "PackedInst must stay eight bytes");
+
+inline const Decoder<const Disassembler::DecoderEntry *> &Disassembler::decoder(IsaLevel level) {
+    static_assert(sizeof(instPatterns) / sizeof(instPatterns[0]) == (std::size_t)Opcode::COUNT,
+        "instruction table and Opcode enum are out of sync");
+    auto build = [](IsaLevel level) {
+        Decoder<const DecoderEntry *> d;
+        for (const DecoderEntry &e : instPatterns) {
+            if (e.isa <= level) {
+                d.add(e.pattern, &e);
+            }
+        }
+        d.build();
+        return d;
+    };
+    if (level == LA32R) {
+        static const Decoder<const DecoderEntry *> la32r = build(LA32R);
+        return la32r;
+    }
+    if (level == LA32) {
+        static const Decoder<const DecoderEntry *> la32 = build(LA32);
+        return la32;
+    }
+    static const Decoder<const DecoderEntry *> la64 = build(LA64);
+    return la64;
+}
+
 }
 
 #endif
@@ -0,0 +1,317 @@
+#ifndef __LADISASSEMBLER_ELF_H__
+#define __LADISASSEMBLER_ELF_H__
+
+#include "la-disassembler.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef EM_LOONGARCH
+#define EM_LOONGARCH 258
+#endif
+
+namespace LADisassembler {
+
+// Address-sorted symbol index. Names point into storage owned by the caller
+// (for ElfImage, the mapped string table), so building it copies no strings.
+class SymbolTable : public SymbolResolver {
+public:
+    struct Symbol {
+        uint64_t addr;
+        uint64_t size;
+        const char *name;
+    };
+
+private:
+    std::vector<Symbol> symbols;
+    bool sorted = true;
+
+public:
+    void add(uint64_t addr, uint64_t size, const char *name) {
+        if (!symbols.empty() && addr < symbols.back().addr) {
+            sorted = false;
+        }
+        symbols.push_back({addr, size, name});
+    }
+
+    // Sorts by address and keeps one symbol per address, preferring sized ones.
+    void finalize() {
+        if (!sorted) {
+            std::stable_sort(symbols.begin(), symbols.end(), [](const Symbol &a, const Symbol &b) {
+                return a.addr < b.addr;
+            });
+            sorted = true;
+        }
+        std::vector<Symbol> unique;
+        for (const Symbol &s : symbols) {
+            if (!unique.empty() && unique.back().addr == s.addr) {
+                if (unique.back().size == 0 && s.size != 0) {
+                    unique.back() = s;
+                }
+                continue;
+            }
+            unique.push_back(s);
+        }
+        symbols.swap(unique);
+    }
+
+    // Nearest symbol at or below addr, or nullptr. O(log n).
+    const Symbol *lookup(uint64_t addr) const {
+        auto it = std::upper_bound(symbols.begin(), symbols.end(), addr, [](uint64_t a, const Symbol &s) {
+            return a < s.addr;
+        });
+        if (it == symbols.begin()) {
+            return nullptr;
+        }
+        return &*(it - 1);
+    }
+
+    // The symbol containing addr. Past the end of a sized symbol (gaps, the PLT,
+    // after the last function) there is none, so the address prints plain; a
+    // symbol without a size covers everything up to the next one.
+    const char *resolve(uint64_t addr, uint64_t &off) const override {
+        const Symbol *s = lookup(addr);
+        if (!s || (s->size != 0 && addr - s->addr >= s->size)) {
+            return nullptr;
+        }
+        off = addr - s->addr;
+        return s->name;
+    }
+
+    const std::vector<Symbol> &all() const {
+        return symbols;
+    }
+
+    std::size_t count() const {
+        return symbols.size();
+    }
+};
+
+// Read-only mapping of a little-endian LoongArch ELF32/ELF64 file. Executable
+// sections are exposed as word spans pointing straight into the mapping, with
+// their load addresses, ready for Disassembler::disassemble_block(). Words are
+// read in host byte order, so this expects a little-endian host.
+class ElfImage {
+public:
+    struct Section {
+        const char *name;
+        uint64_t addr;
+        const uint32_t *words;
+        std::size_t count;
+    };
+
+private:
+    const uint8_t *data = nullptr;
+    std::size_t size = 0;
+    bool is64 = false;
+    std::vector<Section> code;
+    SymbolTable symbolTable;
+
+    struct SectionHeader {
+        uint32_t name;
+        uint32_t type;
+        uint64_t flags;
+        uint64_t addr;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t link;
+        uint64_t entsize;
+    };
+
+    template<typename T>
+    T read(uint64_t offset) const {
+        T v;
+        std::memcpy(&v, data + offset, sizeof(T));
+        return v;
+    }
+
+    bool in_file(uint64_t offset, uint64_t length) const {
+        return offset <= size && length <= size - offset;
+    }
+
+    SectionHeader section_header(uint64_t offset) const {
+        SectionHeader h;
+        if (is64) {
+            Elf64_Shdr s = read<Elf64_Shdr>(offset);
+            h = {s.sh_name, s.sh_type, s.sh_flags, s.sh_addr, s.sh_offset, s.sh_size, s.sh_link, s.sh_entsize};
+        } else {
+            Elf32_Shdr s = read<Elf32_Shdr>(offset);
+            h = {s.sh_name, s.sh_type, s.sh_flags, s.sh_addr, s.sh_offset, s.sh_size, s.sh_link, s.sh_entsize};
+        }
+        return h;
+    }
+
+    const char *string_at(const SectionHeader &strtab, uint32_t index) const {
+        if (index >= strtab.size || !in_file(strtab.offset, strtab.size)) {
+            return "";
+        }
+        const char *s = (const char *)data + strtab.offset + index;
+        // Only hand out names that are terminated inside the table.
+        if (std::memchr(s, '\0', strtab.size - index) == nullptr) {
+            return "";
+        }
+        return s;
+    }
+
+    void load_symbols(const std::vector<SectionHeader> &sections, uint32_t type) {
+        for (const SectionHeader &sh : sections) {
+            if (sh.type != type || sh.link >= sections.size() || !in_file(sh.offset, sh.size)) {
+                continue;
+            }
+            const SectionHeader &strtab = sections[sh.link];
+            std::size_t entsize = is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+            for (uint64_t off = sh.offset; off + entsize <= sh.offset + sh.size; off += entsize) {
+                uint32_t name;
+                uint64_t value, symSize;
+                unsigned char info;
+                uint16_t shndx;
+                if (is64) {
+                    Elf64_Sym s = read<Elf64_Sym>(off);
+                    name = s.st_name; value = s.st_value; symSize = s.st_size; info = s.st_info; shndx = s.st_shndx;
+                } else {
+                    Elf32_Sym s = read<Elf32_Sym>(off);
+                    name = s.st_name; value = s.st_value; symSize = s.st_size; info = s.st_info; shndx = s.st_shndx;
+                }
+                unsigned int symType = ELF64_ST_TYPE(info);
+                if (shndx == SHN_UNDEF || shndx >= SHN_LORESERVE || (symType != STT_FUNC && symType != STT_NOTYPE)) {
+                    continue;
+                }
+                const char *symName = string_at(strtab, name);
+                // Skip unnamed symbols and local assembler labels such as .L123.
+                if (symName[0] == '\0' || (symName[0] == '.' && symName[1] == 'L')) {
+                    continue;
+                }
+                symbolTable.add(value, symSize, symName);
+            }
+        }
+    }
+
+    bool parse() {
+        if (size < EI_NIDENT || std::memcmp(data, ELFMAG, SELFMAG) != 0) {
+            std::cerr << "ElfImage: not an ELF file" << std::endl;
+            return false;
+        }
+        if (data[EI_DATA] != ELFDATA2LSB) {
+            std::cerr << "ElfImage: only little-endian ELF is supported" << std::endl;
+            return false;
+        }
+        is64 = data[EI_CLASS] == ELFCLASS64;
+        if (!is64 && data[EI_CLASS] != ELFCLASS32) {
+            std::cerr << "ElfImage: unknown ELF class" << std::endl;
+            return false;
+        }
+
+        uint16_t machine, shentsize, shnum, shstrndx;
+        uint64_t shoff;
+        if (is64) {
+            if (!in_file(0, sizeof(Elf64_Ehdr))) return false;
+            Elf64_Ehdr e = read<Elf64_Ehdr>(0);
+            machine = e.e_machine; shoff = e.e_shoff; shentsize = e.e_shentsize; shnum = e.e_shnum; shstrndx = e.e_shstrndx;
+        } else {
+            if (!in_file(0, sizeof(Elf32_Ehdr))) return false;
+            Elf32_Ehdr e = read<Elf32_Ehdr>(0);
+            machine = e.e_machine; shoff = e.e_shoff; shentsize = e.e_shentsize; shnum = e.e_shnum; shstrndx = e.e_shstrndx;
+        }
+        if (machine != EM_LOONGARCH) {
+            std::cerr << "ElfImage: not a LoongArch ELF file" << std::endl;
+            return false;
+        }
+        std::size_t expected = is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+        if (shnum == 0 || shentsize != expected || !in_file(shoff, (uint64_t)shnum * shentsize)) {
+            std::cerr << "ElfImage: missing or truncated section headers" << std::endl;
+            return false;
+        }
+
+        std::vector<SectionHeader> sections;
+        for (uint16_t i = 0; i < shnum; i++) {
+            sections.push_back(section_header(shoff + (uint64_t)i * shentsize));
+        }
+        SectionHeader names = shstrndx < shnum ? sections[shstrndx] : SectionHeader();
+
+        for (const SectionHeader &sh : sections) {
+            if (sh.type != SHT_PROGBITS || !(sh.flags & SHF_EXECINSTR) || sh.size == 0) {
+                continue;
+            }
+            if (!in_file(sh.offset, sh.size) || sh.offset % 4 != 0) {
+                std::cerr << "ElfImage: skipping truncated or misaligned section " << string_at(names, sh.name) << std::endl;
+                continue;
+            }
+            code.push_back({string_at(names, sh.name), sh.addr, (const uint32_t *)(data + sh.offset), (std::size_t)(sh.size / 4)});
+        }
+
+        load_symbols(sections, SHT_SYMTAB);
+        if (symbolTable.count() == 0) {
+            load_symbols(sections, SHT_DYNSYM);
+        }
+        symbolTable.finalize();
+        return true;
+    }
+
+public:
+    ElfImage() = default;
+    ElfImage(const ElfImage &) = delete;
+    ElfImage &operator=(const ElfImage &) = delete;
+
+    ~ElfImage() {
+        close();
+    }
+
+    // Maps path and indexes its executable sections and symbols. Returns false
+    // (after reporting why on std::cerr) if the file is not a usable LoongArch ELF.
+    bool open(const char *path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "ElfImage: cannot open " << path << std::endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            std::cerr << "ElfImage: cannot stat " << path << std::endl;
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            std::cerr << "ElfImage: cannot map " << path << std::endl;
+            return false;
+        }
+        data = (const uint8_t *)map;
+        size = st.st_size;
+        if (!parse()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data) {
+            munmap((void *)data, size);
+        }
+        data = nullptr;
+        size = 0;
+        code.clear();
+        symbolTable = SymbolTable();
+    }
+
+    bool elf64() const {
+        return is64;
+    }
+
+    const std::vector<Section> &sections() const {
+        return code;
+    }
+
+    const SymbolTable &symbols() const {
+        return symbolTable;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,423 @@
+#ifndef __LADISASSEMBLER_EXPORT_H__
+#define __LADISASSEMBLER_EXPORT_H__
+
+#include "la-disassembler.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace LADisassembler {
+
+// Binary token stream: decoded instructions as fixed-size records, for tools that
+// would otherwise format text only for the next tool to parse it back.
+//
+// A file is a TokenStreamHeader, recordCount TokenRecords at recordsOffset, and a
+// string table at stringsOffset: stringCount uint32 offsets into the blob of
+// NUL-terminated strings that follows them. Records name their mnemonic by string
+// index. All fields are in the writer's byte order, which byteOrder records; the
+// reader only accepts its own, so in practice files are little-endian.
+//
+// Version 1 stores operand values in 32 bits, which holds every LoongArch operand.
+
+static constexpr char TOKEN_STREAM_MAGIC[8] = {'L', 'A', 'T', 'O', 'K', 'E', 'N', 'S'};
+static constexpr uint16_t TOKEN_STREAM_VERSION = 1;
+static constexpr uint32_t TOKEN_STREAM_BYTE_ORDER = 0x01020304;
+
+// TokenStreamHeader::flags
+static constexpr uint32_t TOKEN_STREAM_MODE32 = 1;   // decoded with the LA32 table
+static constexpr uint32_t TOKEN_STREAM_ALIASES = 2;  // mnemonics include instruction aliases (ret, call)
+static constexpr uint32_t TOKEN_STREAM_REDUCED = 4;  // decoded with the LA32R table
+
+struct TokenStreamHeader {
+    char magic[8];
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t byteOrder;
+    uint32_t flags;
+    uint32_t stringCount;
+    uint64_t recordCount;
+    uint64_t recordsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;  // offsets and blob
+    uint64_t reserved;
+};
+
+struct TokenRecord {
+    static constexpr uint16_t NO_NAME = 0xffff;
+
+    uint64_t pc;
+    uint32_t word;
+    uint16_t opcode;  // Disassembler::Opcode, INVALID if the word did not decode
+    uint16_t name;    // string index of the mnemonic as printed, or NO_NAME
+    uint8_t count;    // operands
+    uint8_t types[Disassembler::MAX_OPERANDS];  // Disassembler::TokenType
+    uint8_t reserved[3];
+    uint32_t operands[Disassembler::MAX_OPERANDS];  // low 32 bits of each value
+};
+
+static_assert(sizeof(TokenStreamHeader) == 64, "token stream header layout changed");
+static_assert(sizeof(TokenRecord) == 40, "token record layout changed");
+
+// Decodes words into a token stream file. Records collect in a large buffer that
+// is written out when full, so memory stays bounded; the string table and the
+// header are written by close().
+class TokenStreamWriter {
+private:
+    static constexpr std::size_t BUFFER_RECORDS = (1 << 20) / sizeof(TokenRecord);
+    static constexpr std::size_t BATCH = 256;
+
+    const Disassembler &disassembler;
+    FormatOptions opt;
+    int fd = -1;
+    bool failed = false;
+    uint64_t records = 0;
+    std::vector<TokenRecord> buffer;
+    std::vector<std::string> strings;
+    std::vector<uint16_t> canonicalName;  // per opcode, NO_NAME until first seen
+    std::vector<std::pair<const char *, uint16_t>> aliasNames;
+
+    bool write_all(const void *data, std::size_t n) {
+        const char *p = (const char *)data;
+        while (n) {
+            ssize_t done = ::write(fd, p, n);
+            if (done < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "TokenStreamWriter: write failed" << std::endl;
+                failed = true;
+                return false;
+            }
+            p += done;
+            n -= done;
+        }
+        return true;
+    }
+
+    bool flush() {
+        bool ok = buffer.empty() || write_all(buffer.data(), buffer.size() * sizeof(TokenRecord));
+        buffer.clear();
+        return ok;
+    }
+
+    uint16_t intern(const char *name) {
+        strings.push_back(name);
+        return strings.size() - 1;
+    }
+
+    uint16_t name_index(Disassembler::Opcode opcode, const char *name) {
+        if (name == Disassembler::mnemonic(opcode)) {
+            uint16_t &index = canonicalName[(std::size_t)opcode];
+            if (index == TokenRecord::NO_NAME) {
+                index = intern(name);
+            }
+            return index;
+        }
+        for (const auto &alias : aliasNames) {
+            if (alias.first == name) {
+                return alias.second;
+            }
+        }
+        aliasNames.push_back({name, intern(name)});
+        return aliasNames.back().second;
+    }
+
+public:
+    TokenStreamWriter(const Disassembler &disassembler) : disassembler(disassembler) {}
+    TokenStreamWriter(const TokenStreamWriter &) = delete;
+    TokenStreamWriter &operator=(const TokenStreamWriter &) = delete;
+
+    ~TokenStreamWriter() {
+        close();
+    }
+
+    // Creates path (truncating it). Of the options, mode32, reduced and
+    // instAlias apply.
+    bool open(const char *path, const FormatOptions &opt) {
+        close();
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "TokenStreamWriter: cannot create " << path << std::endl;
+            return false;
+        }
+        this->opt = opt;
+        failed = false;
+        records = 0;
+        buffer.reserve(BUFFER_RECORDS);
+        strings.clear();
+        canonicalName.assign((std::size_t)Disassembler::Opcode::COUNT, TokenRecord::NO_NAME);
+        aliasNames.clear();
+        // Records start after the header, which close() fills in.
+        TokenStreamHeader header = {};
+        return write_all(&header, sizeof(header));
+    }
+
+    bool open(const char *path) {
+        return open(path, disassembler.options());
+    }
+
+    // Appends one record per word of words[0..n), at consecutive PCs from base_pc.
+    bool write(const uint32_t *words, std::size_t n, uint64_t base_pc) {
+        if (fd < 0 || failed) {
+            return false;
+        }
+        Disassembler::PackedInst packed[BATCH];
+        Disassembler::DecodeTokenArray tokens;
+        for (std::size_t at = 0; at < n; at += BATCH) {
+            std::size_t m = std::min(BATCH, n - at);
+            Disassembler::pack_block(words + at, m, packed);
+            for (std::size_t i = 0; i < m; i++) {
+                TokenRecord r = {};
+                r.pc = base_pc + 4 * (uint64_t)(at + i);
+                r.word = words[at + i];
+                r.opcode = (uint16_t)Disassembler::Opcode::INVALID;
+                r.name = TokenRecord::NO_NAME;
+                if (disassembler.disassemble_to_tokens(packed[i], tokens, opt)) {
+                    r.opcode = (uint16_t)packed[i].opcode;
+                    r.name = name_index(packed[i].opcode, tokens.tokens[0].str);
+                    for (unsigned int k = 1; k <= Disassembler::MAX_OPERANDS && tokens.tokens[k].type != Disassembler::END; k++) {
+                        r.types[r.count] = tokens.tokens[k].type;
+                        r.operands[r.count] = (uint32_t)tokens.tokens[k].num;
+                        r.count++;
+                    }
+                }
+                buffer.push_back(r);
+                if (buffer.size() == BUFFER_RECORDS && !flush()) {
+                    return false;
+                }
+            }
+        }
+        records += n;
+        return true;
+    }
+
+    // Records written so far.
+    uint64_t count() const {
+        return records;
+    }
+
+    // Writes the string table and header and closes the file. Returns false if any
+    // write failed.
+    bool close() {
+        if (fd < 0) {
+            return true;
+        }
+        bool ok = !failed && flush();
+        TokenStreamHeader header = {};
+        std::memcpy(header.magic, TOKEN_STREAM_MAGIC, sizeof(header.magic));
+        header.version = TOKEN_STREAM_VERSION;
+        header.recordSize = sizeof(TokenRecord);
+        header.byteOrder = TOKEN_STREAM_BYTE_ORDER;
+        header.flags = (opt.mode32 ? TOKEN_STREAM_MODE32 : 0) | (opt.instAlias ? TOKEN_STREAM_ALIASES : 0) |
+            (opt.mode32 && opt.reduced ? TOKEN_STREAM_REDUCED : 0);
+        header.stringCount = strings.size();
+        header.recordCount = records;
+        header.recordsOffset = sizeof(TokenStreamHeader);
+        header.stringsOffset = header.recordsOffset + records * sizeof(TokenRecord);
+
+        std::vector<uint32_t> offsets;
+        std::string blob;
+        for (const std::string &s : strings) {
+            offsets.push_back(blob.size());
+            blob.append(s.c_str(), s.size() + 1);
+        }
+        header.stringsSize = offsets.size() * sizeof(uint32_t) + blob.size();
+        ok = ok && write_all(offsets.data(), offsets.size() * sizeof(uint32_t)) && write_all(blob.data(), blob.size());
+        if (ok && pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            std::cerr << "TokenStreamWriter: cannot write header" << std::endl;
+            ok = false;
+        }
+        ok = ::close(fd) == 0 && ok;
+        fd = -1;
+        return ok;
+    }
+};
+
+// Zero-copy view of a token stream: records are read in place from a read-only
+// mapping of the file, or from a buffer the caller keeps alive.
+class TokenStreamReader {
+private:
+    const uint8_t *data = nullptr;
+    std::size_t size = 0;
+    bool mapped = false;
+    TokenStreamHeader header = {};
+    const TokenRecord *recordData = nullptr;
+    const uint32_t *stringOffsets = nullptr;
+    const char *blob = nullptr;
+    std::size_t blobSize = 0;
+
+    bool parse() {
+        if (size < sizeof(TokenStreamHeader)) {
+            std::cerr << "TokenStreamReader: file too short" << std::endl;
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, TOKEN_STREAM_MAGIC, sizeof(header.magic)) != 0) {
+            std::cerr << "TokenStreamReader: not a token stream" << std::endl;
+            return false;
+        }
+        if (header.byteOrder != TOKEN_STREAM_BYTE_ORDER) {
+            std::cerr << "TokenStreamReader: written with another byte order" << std::endl;
+            return false;
+        }
+        if (header.version != TOKEN_STREAM_VERSION || header.recordSize != sizeof(TokenRecord)) {
+            std::cerr << "TokenStreamReader: unsupported version " << header.version << std::endl;
+            return false;
+        }
+        uint64_t stringsMin = (uint64_t)header.stringCount * sizeof(uint32_t);
+        if (header.recordsOffset % alignof(TokenRecord) != 0 || header.recordsOffset > size ||
+                header.recordCount > (size - header.recordsOffset) / sizeof(TokenRecord) ||
+                header.stringsOffset % alignof(uint32_t) != 0 || header.stringsOffset > size ||
+                header.stringsSize > size - header.stringsOffset || header.stringsSize < stringsMin) {
+            std::cerr << "TokenStreamReader: truncated or corrupt file" << std::endl;
+            return false;
+        }
+        recordData = (const TokenRecord *)(data + header.recordsOffset);
+        stringOffsets = (const uint32_t *)(data + header.stringsOffset);
+        blob = (const char *)(data + header.stringsOffset + stringsMin);
+        blobSize = header.stringsSize - stringsMin;
+        // Check once that every string ends inside the blob, so string() need not.
+        for (uint32_t i = 0; i < header.stringCount; i++) {
+            if (stringOffsets[i] >= blobSize || std::memchr(blob + stringOffsets[i], '\0', blobSize - stringOffsets[i]) == nullptr) {
+                std::cerr << "TokenStreamReader: corrupt string table" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    TokenStreamReader() = default;
+    TokenStreamReader(const TokenStreamReader &) = delete;
+    TokenStreamReader &operator=(const TokenStreamReader &) = delete;
+
+    ~TokenStreamReader() {
+        close();
+    }
+
+    // Maps path read-only. Returns false (after reporting why on std::cerr) if it is
+    // not a token stream this reader understands.
+    bool open(const char *path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "TokenStreamReader: cannot open " << path << std::endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            std::cerr << "TokenStreamReader: cannot stat " << path << std::endl;
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            std::cerr << "TokenStreamReader: cannot map " << path << std::endl;
+            return false;
+        }
+        data = (const uint8_t *)map;
+        size = st.st_size;
+        mapped = true;
+        if (!parse()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // Reads a stream already in memory, aligned for TokenRecord; the buffer must
+    // outlive the reader.
+    bool open(const void *buffer, std::size_t length) {
+        close();
+        data = (const uint8_t *)buffer;
+        size = length;
+        if ((uintptr_t)buffer % alignof(TokenRecord) != 0) {
+            std::cerr << "TokenStreamReader: misaligned buffer" << std::endl;
+            close();
+            return false;
+        }
+        if (!parse()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (mapped) {
+            munmap((void *)data, size);
+        }
+        data = nullptr;
+        size = 0;
+        mapped = false;
+        header = TokenStreamHeader();
+        recordData = nullptr;
+        stringOffsets = nullptr;
+        blob = nullptr;
+        blobSize = 0;
+    }
+
+    uint32_t flags() const {
+        return header.flags;
+    }
+
+    uint64_t count() const {
+        return header.recordCount;
+    }
+
+    const TokenRecord *begin() const {
+        return recordData;
+    }
+
+    const TokenRecord *end() const {
+        return recordData + header.recordCount;
+    }
+
+    const TokenRecord &operator[](uint64_t index) const {
+        return recordData[index];
+    }
+
+    uint32_t string_count() const {
+        return header.stringCount;
+    }
+
+    // String table entry, or "" for an index out of range.
+    const char *string(uint32_t index) const {
+        return index < header.stringCount ? blob + stringOffsets[index] : "";
+    }
+
+    const char *name(const TokenRecord &r) const {
+        return string(r.name);
+    }
+
+    // Rebuilds the tokens the record was written from, with the mnemonic pointing
+    // into the string table, ready for Disassembler::fmt_tokens_to(). Returns false
+    // for a word that did not decode.
+    bool tokens(const TokenRecord &r, Disassembler::DecodeTokenArray &out) const {
+        if (r.opcode >= (uint16_t)Disassembler::Opcode::COUNT || r.count > Disassembler::MAX_OPERANDS) {
+            out = Disassembler::DecodeTokenArray();
+            return false;
+        }
+        out.tokens[0].type = Disassembler::NAME;
+        out.tokens[0].str = name(r);
+        for (unsigned int i = 0; i < r.count; i++) {
+            Disassembler::TokenType type = (Disassembler::TokenType)r.types[i];
+            bool sign = type == Disassembler::SIMM32 || type == Disassembler::SIMM64 ||
+                type == Disassembler::PCOFF || type == Disassembler::ADDROFF;
+            out.tokens[i + 1].type = type;
+            out.tokens[i + 1].num = sign ? (uint64_t)(int64_t)(int32_t)r.operands[i] : r.operands[i];
+        }
+        if (r.count < Disassembler::MAX_OPERANDS) {
+            out.tokens[r.count + 1].type = Disassembler::END;
+        }
+        return true;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef __LADISASSEMBLER_INCREMENTAL_H__
+#define __LADISASSEMBLER_INCREMENTAL_H__
+
+#include "la-disassembler.h"
+
+namespace LADisassembler {
+
+// A listing of a code region that is kept up to date as the code changes, for
+// debuggers and simulators that re-dump the same region after patches or
+// self-modifying writes.
+//
+// The region is split into fixed-size pages, each holding its formatted lines
+// and a hash of its words. update() takes a new snapshot of the region and
+// re-formats only the pages whose hash changed: formatting follows the size of
+// the edit, but every call still hashes the whole region. mark_dirty() plus
+// update_dirty() skip the hashing when the writer knows what it touched, so only
+// they cost in proportion to the edit alone. changed() names the pages that
+// were redone.
+//
+// Not thread-safe. The disassembler must outlive the listing.
+class IncrementalListing {
+public:
+    struct Options {
+        std::size_t pageWords = 1024;  // words per page (4 KiB)
+        bool addresses = false;        // prefix lines with "pc:  word  "
+    };
+
+private:
+    struct Page {
+        uint64_t hash = 0;
+        bool dirty = false;
+        std::string text;             // one line per word, each ending in '\n'
+        std::vector<uint32_t> lines;  // where each line starts in text
+    };
+
+    const Disassembler &disassembler;
+    Options options;
+    FormatOptions opt;
+    uint64_t basePc = 0;
+    std::size_t words = 0;
+    std::vector<Page> pages;
+    std::vector<std::size_t> changedPages;
+
+    static uint64_t hash_words(const uint32_t *words, std::size_t n) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (std::size_t i = 0; i < n; i++) {
+            h = (h ^ words[i]) * 0x100000001b3ULL;
+        }
+        return h ^ h >> 32;
+    }
+
+    std::size_t page_words(std::size_t page) const {
+        return std::min(options.pageWords, words - page * options.pageWords);
+    }
+
+    void format_page(const uint32_t *image, std::size_t page) {
+        Page &p = pages[page];
+        const std::size_t at = page * options.pageWords;
+        const std::size_t n = page_words(page);
+        p.text.clear();
+        p.lines.clear();
+        auto line = [this, &p](uint64_t pc, uint32_t inst, const char *text, std::size_t length) {
+            p.lines.push_back(p.text.size());
+            if (options.addresses) {
+                char head[40];
+                TextWriter w(head, sizeof(head));
+                w.put_hex(pc, 8);
+                w.put(":  ", 3);
+                w.put_hex(inst, 8);
+                w.put("  ", 2);
+                p.text.append(head, w.finish());
+            }
+            p.text.append(text, length);
+            p.text.push_back('\n');
+        };
+        disassembler.disassemble_block(image + at, n, basePc + 4 * (uint64_t)at, line, opt);
+        p.hash = hash_words(image + at, n);
+        p.dirty = false;
+        changedPages.push_back(page);
+    }
+
+public:
+    IncrementalListing(const Disassembler &disassembler) : IncrementalListing(disassembler, Options()) {}
+
+    IncrementalListing(const Disassembler &disassembler, const Options &options)
+        : disassembler(disassembler), options(options), opt(disassembler.options()) {
+        if (this->options.pageWords == 0) {
+            this->options.pageWords = 1;
+        }
+    }
+
+    // Formats all of words[0..n) at base_pc, replacing any earlier region. Later
+    // snapshots must have the same size and base.
+    void load(const uint32_t *image, std::size_t n, uint64_t base_pc, const FormatOptions &opt) {
+        this->opt = opt;
+        basePc = base_pc;
+        words = n;
+        pages.clear();
+        pages.resize((n + options.pageWords - 1) / options.pageWords);
+        changedPages.clear();
+        for (std::size_t page = 0; page < pages.size(); page++) {
+            format_page(image, page);
+        }
+    }
+
+    void load(const uint32_t *image, std::size_t n, uint64_t base_pc) {
+        load(image, n, base_pc, disassembler.options());
+    }
+
+    // Compares a new snapshot of the region page by page and re-formats the pages
+    // that differ or were marked dirty. Returns the number of pages re-formatted.
+    std::size_t update(const uint32_t *image) {
+        changedPages.clear();
+        for (std::size_t page = 0; page < pages.size(); page++) {
+            const Page &p = pages[page];
+            if (p.dirty || hash_words(image + page * options.pageWords, page_words(page)) != p.hash) {
+                format_page(image, page);
+            }
+        }
+        return changedPages.size();
+    }
+
+    // Notes that [addr, addr + bytes) was written; the next update_dirty() or
+    // update() re-formats the pages it touches. Parts outside the region are ignored.
+    void mark_dirty(uint64_t addr, std::size_t bytes) {
+        const uint64_t end = basePc + 4 * (uint64_t)words;
+        uint64_t from = std::max(addr, basePc);
+        uint64_t to = std::min(addr + bytes, end);
+        if (bytes == 0 || from >= to) {
+            return;
+        }
+        std::size_t first = (from - basePc) / 4 / options.pageWords;
+        std::size_t last = (to - 1 - basePc) / 4 / options.pageWords;
+        for (std::size_t page = first; page <= last; page++) {
+            pages[page].dirty = true;
+        }
+    }
+
+    // Re-formats only the pages marked dirty, reading them from image, without
+    // looking at the others. Returns the number of pages re-formatted.
+    std::size_t update_dirty(const uint32_t *image) {
+        changedPages.clear();
+        for (std::size_t page = 0; page < pages.size(); page++) {
+            if (pages[page].dirty) {
+                format_page(image, page);
+            }
+        }
+        return changedPages.size();
+    }
+
+    uint64_t base() const {
+        return basePc;
+    }
+
+    // Region size in instructions.
+    std::size_t size() const {
+        return words;
+    }
+
+    std::size_t page_count() const {
+        return pages.size();
+    }
+
+    // Pages re-formatted by the last load() or update, in address order.
+    const std::vector<std::size_t> &changed() const {
+        return changedPages;
+    }
+
+    // Lines of one page, each ending in '\n'; invalid words give empty lines.
+    const std::string &page_text(std::size_t page) const {
+        return pages[page].text;
+    }
+
+    // Text of the line for word index, without its '\n'.
+    const char *line(std::size_t index, std::size_t &length) const {
+        const Page &p = pages[index / options.pageWords];
+        std::size_t i = index % options.pageWords;
+        std::size_t start = p.lines[i];
+        std::size_t end = i + 1 < p.lines.size() ? p.lines[i + 1] : p.text.size();
+        length = end - start - 1;
+        return p.text.data() + start;
+    }
+
+    std::string line(std::size_t index) const {
+        std::size_t length;
+        const char *text = line(index, length);
+        return std::string(text, length);
+    }
+
+    // Calls out(text, length) with the whole listing, a page at a time.
+    template<typename Output>
+    void write(Output &&out) const {
+        for (const Page &p : pages) {
+            out((const char *)p.text.data(), p.text.size());
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef __LADISASSEMBLER_PACKED_H__
+#define __LADISASSEMBLER_PACKED_H__
+
+#include "la-disassembler.h"
+
+namespace LADisassembler {
+
+// Columnar store for long decoded traces, e.g. for reverse stepping. Each
+// instruction costs 16 bytes (PC, opcode, registers, immediate) against roughly
+// 64 for a DecodeTokenArray, and each field lives in its own array so that a scan
+// over one field (say, every opcode) reads only that field's bytes.
+class PackedTrace {
+    static constexpr std::size_t CHUNK = 256;
+
+    std::vector<uint64_t> pcs;
+    std::vector<Disassembler::Opcode> opcodes;
+    std::vector<uint16_t> regs;
+    std::vector<int32_t> imms;
+
+public:
+    std::size_t size() const {
+        return pcs.size();
+    }
+
+    bool empty() const {
+        return pcs.empty();
+    }
+
+    // Bytes held by the columns, excluding unused capacity.
+    std::size_t bytes() const {
+        return size() * (sizeof(uint64_t) + sizeof(Disassembler::Opcode) + sizeof(uint16_t) + sizeof(int32_t));
+    }
+
+    void reserve(std::size_t n) {
+        pcs.reserve(n);
+        opcodes.reserve(n);
+        regs.reserve(n);
+        imms.reserve(n);
+    }
+
+    void clear() {
+        pcs.clear();
+        opcodes.clear();
+        regs.clear();
+        imms.clear();
+    }
+
+    // Appends one executed instruction. Returns false if the word is not a valid
+    // instruction; it is still recorded, with opcode INVALID.
+    bool push(uint64_t pc, uint32_t inst) {
+        Disassembler::PackedInst p;
+        bool valid = Disassembler::pack(inst, p);
+        push(pc, p);
+        return valid;
+    }
+
+    void push(uint64_t pc, const Disassembler::PackedInst &p) {
+        pcs.push_back(pc);
+        opcodes.push_back(p.opcode);
+        regs.push_back(p.regs);
+        imms.push_back(p.imm);
+    }
+
+    // Appends n consecutive words starting at base_pc. Returns the number of valid words.
+    std::size_t append(const uint32_t *words, std::size_t n, uint64_t base_pc) {
+        Disassembler::PackedInst packed[CHUNK];
+        std::size_t valid = 0;
+        reserve(size() + n);
+        for (std::size_t at = 0; at < n; at += CHUNK) {
+            std::size_t m = std::min(CHUNK, n - at);
+            valid += Disassembler::pack_block(words + at, m, packed);
+            for (std::size_t i = 0; i < m; i++) {
+                push(base_pc + 4 * (at + i), packed[i]);
+            }
+        }
+        return valid;
+    }
+
+    uint64_t pc(std::size_t i) const {
+        return pcs[i];
+    }
+
+    Disassembler::Opcode opcode(std::size_t i) const {
+        return opcodes[i];
+    }
+
+    Disassembler::PackedInst at(std::size_t i) const {
+        Disassembler::PackedInst p;
+        p.opcode = opcodes[i];
+        p.regs = regs[i];
+        p.imm = imms[i];
+        return p;
+    }
+
+    uint32_t word(std::size_t i) const {
+        return Disassembler::unpack(at(i));
+    }
+
+    bool expand(const Disassembler &disassembler, std::size_t i, Disassembler::DecodeTokenArray &tokens) const {
+        return disassembler.disassemble_to_tokens(at(i), tokens);
+    }
+
+    std::string disassemble(const Disassembler &disassembler, std::size_t i) const {
+        return disassembler.disassemble(word(i), pcs[i]);
+    }
+
+    // Raw columns, each size() long, for scans over a single field.
+    const uint64_t *pc_column() const { return pcs.data(); }
+    const Disassembler::Opcode *opcode_column() const { return opcodes.data(); }
+    const uint16_t *regs_column() const { return regs.data(); }
+    const int32_t *imm_column() const { return imms.data(); }
+};
+
+}
+
+#endif
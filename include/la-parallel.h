@@ -0,0 +1,262 @@
+#ifndef __LADISASSEMBLER_PARALLEL_H__
+#define __LADISASSEMBLER_PARALLEL_H__
+
+#include "la-cfg.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace LADisassembler {
+
+// Disassembles large images on a pool of worker threads. The input is cut into
+// fixed-size chunks that workers format into their own reusable buffers; the
+// calling thread hands finished chunks to the output strictly in address order.
+// At most window() chunks are in flight, so memory stays bounded by the chunk
+// size rather than the image size.
+//
+// The pool is started by the first run() that needs it and kept, idle between
+// calls, until destruction, so a caller that feeds a stream block by block starts
+// its threads once. One run() at a time.
+class ParallelDisassembler {
+public:
+    struct Options {
+        unsigned int threads = 0;          // 0: one per hardware thread
+        std::size_t chunkWords = 1 << 14;  // words per work item
+        bool addresses = false;            // prefix lines with "pc:  word  "
+        // Put an "L_<addr>:" line before each branch target it knows; nullptr for
+        // none. Must cover the words passed to run() and outlive the call.
+        const ControlFlowGraph *labels = nullptr;
+        // Put a "\n<name>:" line where a symbol starts, in place of its label;
+        // nullptr for none.
+        const SymbolResolver *symbols = nullptr;
+    };
+
+private:
+    struct Slot {
+        std::string text;
+        bool ready = false;
+    };
+
+    // The words of the current run().
+    struct Job {
+        const uint32_t *words = nullptr;
+        std::size_t n = 0;
+        uint64_t basePc = 0;
+        std::size_t chunks = 0;
+    };
+
+    const Disassembler &disassembler;
+    Options options;
+
+    // Pool state, all guarded by lock.
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<std::thread> pool;
+    std::vector<Slot> slot;
+    Job job;
+    std::size_t next = 0;     // next chunk to hand to a worker
+    std::size_t emitted = 0;  // chunks already passed to out
+    std::size_t working = 0;  // workers formatting a chunk
+    bool active = false;      // a run() is handing out chunks
+    bool abort = false;
+    bool stopping = false;
+    std::exception_ptr error;  // first failure of a worker in this run()
+
+    void format_chunk(const uint32_t *words, std::size_t n, uint64_t pc, std::string &out) const {
+        out.clear();
+        if (!options.addresses && !options.labels && !options.symbols) {
+            disassembler.disassemble_block(words, n, pc, out);
+            return;
+        }
+        auto line = [this, &out](uint64_t pc, uint32_t inst, const char *text, std::size_t length) {
+            char head[40];
+            uint64_t off = 0;
+            const char *name = options.symbols ? options.symbols->resolve(pc, off) : nullptr;
+            if (name && off == 0) {
+                out.append("\n<", 2);
+                out.append(name);
+                out.append(">:\n", 3);
+            } else if (options.labels && options.labels->is_target(pc)) {
+                std::size_t n = ControlFlowGraph::format_label(head, sizeof(head), pc);
+                out.append(head, n);
+                out.append(":\n", 2);
+            }
+            if (!options.addresses) {
+                out.append(text, length);
+                out.push_back('\n');
+                return;
+            }
+            TextWriter w(head, sizeof(head));
+            w.put_hex(pc, 8);
+            w.put(":  ", 3);
+            w.put_hex(inst, 8);
+            w.put("  ", 2);
+            out.append(head, w.finish());
+            out.append(text, length);
+            out.push_back('\n');
+        };
+        disassembler.disassemble_block(words, n, pc, line);
+    }
+
+    // A worker that throws (bad_alloc growing its buffer) records the error and
+    // stops the run instead of letting the exception escape its thread.
+    void worker() {
+        std::string scratch;
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            changed.wait(guard, [this] {
+                return stopping || (active && !abort && next < job.chunks && next < emitted + slot.size());
+            });
+            if (stopping) {
+                return;
+            }
+            const std::size_t c = next++;
+            const Job j = job;
+            working++;
+            guard.unlock();
+            std::exception_ptr failure;
+            try {
+                std::size_t at = c * options.chunkWords;
+                format_chunk(j.words + at, std::min(options.chunkWords, j.n - at), j.basePc + 4 * at, scratch);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            guard.lock();
+            if (failure) {
+                if (!error) {
+                    error = failure;
+                }
+                abort = true;
+            } else {
+                slot[c % slot.size()].text.swap(scratch);
+                slot[c % slot.size()].ready = true;
+            }
+            working--;
+            changed.notify_all();
+        }
+    }
+
+public:
+    ParallelDisassembler(const Disassembler &disassembler) : ParallelDisassembler(disassembler, Options()) {}
+
+    ParallelDisassembler(const Disassembler &disassembler, const Options &options)
+        : disassembler(disassembler), options(options) {
+        if (this->options.threads == 0) {
+            this->options.threads = std::max(1U, std::thread::hardware_concurrency());
+        }
+        if (this->options.chunkWords == 0) {
+            this->options.chunkWords = 1;
+        }
+        slot.resize(window());
+    }
+
+    ParallelDisassembler(const ParallelDisassembler &) = delete;
+    ParallelDisassembler &operator=(const ParallelDisassembler &) = delete;
+
+    ~ParallelDisassembler() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (std::thread &t : pool) {
+            t.join();
+        }
+    }
+
+    unsigned int threads() const {
+        return options.threads;
+    }
+
+    std::size_t window() const {
+        return 2 * options.threads;
+    }
+
+    // Disassembles words[0..n) at base_pc and calls out(text, length) with
+    // consecutive pieces of the listing, in address order, on the calling thread.
+    // An exception from out or from a worker is rethrown once no worker is still
+    // reading words.
+    template<typename Output>
+    void run(const uint32_t *words, std::size_t n, uint64_t base_pc, Output &&out) {
+        const std::size_t chunkWords = options.chunkWords;
+        const std::size_t chunks = (n + chunkWords - 1) / chunkWords;
+        const std::size_t slots = slot.size();
+
+        if (options.threads == 1 || chunks <= 1) {
+            std::string text;
+            for (std::size_t c = 0; c < chunks; c++) {
+                std::size_t at = c * chunkWords;
+                format_chunk(words + at, std::min(chunkWords, n - at), base_pc + 4 * at, text);
+                out((const char *)text.data(), text.size());
+            }
+            return;
+        }
+
+        std::unique_lock<std::mutex> guard(lock);
+        // Threads that did start are kept, and joined by the destructor, if a later
+        // one fails to; the run goes on with them.
+        try {
+            while (pool.size() < options.threads) {
+                pool.emplace_back(&ParallelDisassembler::worker, this);
+            }
+        } catch (...) {
+            if (pool.empty()) {
+                throw;
+            }
+        }
+        job = Job{words, n, base_pc, chunks};
+        next = 0;
+        emitted = 0;
+        abort = false;
+        error = nullptr;
+        for (Slot &s : slot) {
+            s.ready = false;
+        }
+        active = true;
+        changed.notify_all();
+
+        std::exception_ptr failure;
+        std::string text;
+        for (std::size_t c = 0; c < chunks; c++) {
+            changed.wait(guard, [&] { return abort || slot[c % slots].ready; });
+            if (abort) {
+                break;
+            }
+            // Take the text and leave this buffer for the worker that reuses the slot.
+            text.swap(slot[c % slots].text);
+            slot[c % slots].ready = false;
+            emitted++;
+            changed.notify_all();
+            guard.unlock();
+            try {
+                out((const char *)text.data(), text.size());
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            guard.lock();
+            if (failure) {
+                break;
+            }
+        }
+
+        // Stop handing out chunks and wait until no worker still reads words.
+        abort = true;
+        changed.wait(guard, [this] { return working == 0; });
+        active = false;
+        if (!failure) {
+            failure = error;
+        }
+        error = nullptr;
+        guard.unlock();
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+};
+
+}
+
+#endif
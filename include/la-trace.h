@@ -0,0 +1,185 @@
+#ifndef __LADISASSEMBLER_TRACE_H__
+#define __LADISASSEMBLER_TRACE_H__
+
+#include "la-disassembler.h"
+
+#include <atomic>
+
+namespace LADisassembler {
+
+// Fixed-size record of the most recently executed instructions. The execution
+// path only stores raw (pc, word) pairs; decoding and formatting happen when the
+// trace is dumped or drained, off that path.
+//
+// One producer thread calls record(). It never blocks: once the ring is full the
+// oldest records are overwritten. One consumer thread may drain() concurrently;
+// records the producer overwrites before the consumer gets to them are counted in
+// dropped() and skipped rather than returned torn. dump() does not consume and is
+// meant for crash reports, from any thread.
+class InstructionTrace {
+public:
+    struct Record {
+        uint64_t pc;
+        uint32_t inst;
+    };
+
+private:
+    // Slots are atomics so that a consumer racing the producer reads a stale or
+    // fresh value rather than invoking a data race; all accesses are relaxed and
+    // compile to plain loads and stores.
+    struct Slot {
+        std::atomic<uint64_t> pc{0};
+        std::atomic<uint32_t> inst{0};
+    };
+
+    static constexpr std::size_t CHUNK = 256;
+
+    std::vector<Slot> slots;
+    uint64_t mask;
+    alignas(64) std::atomic<uint64_t> head{0}; // records ever written, producer-owned
+    alignas(64) std::atomic<uint64_t> tail{0}; // records consumed, consumer-owned
+    std::atomic<uint64_t> droppedCount{0};
+
+    // Copies records [from, to) out of the ring, then drops those the producer may
+    // have overwritten meanwhile. Returns the index of the first good record in out.
+    std::size_t snapshot(uint64_t from, uint64_t to, Record *out, uint64_t &first) const {
+        for (uint64_t i = from; i < to; i++) {
+            const Slot &s = slots[i & mask];
+            out[i - from].pc = s.pc.load(std::memory_order_relaxed);
+            out[i - from].inst = s.inst.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The writer of record i + capacity published head >= i + capacity before
+        // touching slot i, so anything below head - capacity + 1 may be torn.
+        uint64_t now = head.load(std::memory_order_relaxed);
+        first = std::max(from, now >= slots.size() ? now - slots.size() + 1 : 0);
+        return std::min<uint64_t>(first, to) - from;
+    }
+
+    template<typename Sink>
+    static void format(const Disassembler &disassembler, const Record &r, Sink &sink) {
+        char text[256];
+        std::size_t length = disassembler.disassemble_to(text, sizeof(text), r.inst, r.pc);
+        if (length < sizeof(text)) {
+            sink(r.pc, r.inst, (const char *)text, length);
+            return;
+        }
+        // A long symbol name: retry once into a string of the measured size.
+        std::string big(length + 1, '\0');
+        disassembler.disassemble_to(&big[0], big.size(), r.inst, r.pc);
+        big.resize(length);
+        sink(r.pc, r.inst, big.c_str(), big.size());
+    }
+
+public:
+    // Keeps at least the last capacity records. One slot beyond that is always
+    // reserved for the record being written, so the ring is a power of two larger.
+    explicit InstructionTrace(std::size_t capacity = (1 << 16) - 1) {
+        std::size_t size = 2;
+        while (size < capacity + 1) {
+            size <<= 1;
+        }
+        slots = std::vector<Slot>(size);
+        mask = size - 1;
+    }
+
+    InstructionTrace(const InstructionTrace &) = delete;
+    InstructionTrace &operator=(const InstructionTrace &) = delete;
+
+    std::size_t capacity() const {
+        return slots.size() - 1;
+    }
+
+    // Records written so far, including overwritten ones.
+    uint64_t recorded() const {
+        return head.load(std::memory_order_acquire);
+    }
+
+    // Records the consumer lost to overwriting.
+    uint64_t dropped() const {
+        return droppedCount.load(std::memory_order_relaxed);
+    }
+
+    // Producer side: the only work on the execution path.
+    void record(uint64_t pc, uint32_t inst) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        // Keeps the previous head store ahead of the slot stores below, so a reader
+        // that sees the new slot contents also sees head >= h.
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot &s = slots[h & mask];
+        s.pc.store(pc, std::memory_order_relaxed);
+        s.inst.store(inst, std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Consumer side: passes every record not yet drained to sink(pc, inst), oldest
+    // first. Returns the number of records delivered.
+    template<typename Sink>
+    std::size_t drain(Sink &&sink) {
+        Record chunk[CHUNK];
+        std::size_t delivered = 0;
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        while (t < h) {
+            uint64_t oldest = h > capacity() ? h - capacity() : 0;
+            if (t < oldest) {
+                droppedCount.fetch_add(oldest - t, std::memory_order_relaxed);
+                t = oldest;
+            }
+            uint64_t to = std::min<uint64_t>(h, t + CHUNK);
+            uint64_t first;
+            std::size_t skip = snapshot(t, to, chunk, first);
+            if (first > t) {
+                droppedCount.fetch_add(std::min(first, to) - t, std::memory_order_relaxed);
+            }
+            for (std::size_t i = skip; i < to - t; i++) {
+                sink(chunk[i].pc, chunk[i].inst);
+                delivered++;
+            }
+            t = to;
+            h = head.load(std::memory_order_acquire);
+        }
+        tail.store(t, std::memory_order_relaxed);
+        return delivered;
+    }
+
+    // drain() with formatting: sink(pc, inst, text, length) for each valid record;
+    // undecodable words produce empty text.
+    template<typename Sink>
+    std::size_t drain(const Disassembler &disassembler, Sink &&sink) {
+        return drain([&](uint64_t pc, uint32_t inst) {
+            format(disassembler, Record{pc, inst}, sink);
+        });
+    }
+
+    // Formats the last n records (all retained ones by default), oldest first, as
+    // "pc:  text" lines, without consuming them. Returns the number written.
+    std::size_t dump(const Disassembler &disassembler, std::ostream &out, std::size_t n = SIZE_MAX) const {
+        uint64_t h = head.load(std::memory_order_acquire);
+        uint64_t from = h - std::min<uint64_t>({h, capacity(), n});
+        std::size_t written = 0;
+        auto line = [&out, &written](uint64_t pc, uint32_t, const char *text, std::size_t length) {
+            char address[24];
+            TextWriter w(address, sizeof(address));
+            w.put_hex(pc, 16);
+            w.put(":  ", 3);
+            out.write(address, w.finish());
+            out.write(text, length);
+            out.put('\n');
+            written++;
+        };
+        Record chunk[CHUNK];
+        for (uint64_t t = from; t < h; t += CHUNK) {
+            uint64_t to = std::min<uint64_t>(h, t + CHUNK);
+            uint64_t first;
+            for (std::size_t i = snapshot(t, to, chunk, first); i < to - t; i++) {
+                format(disassembler, chunk[i], line);
+            }
+        }
+        return written;
+    }
+};
+
+}
+
+#endif
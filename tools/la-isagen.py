@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""Generates the decoder tables from the LoongArch ISA description.
+
+    la-isagen.py isa/loongarch.isa include/
+
+reads the description and writes include/la-formats.def (operand layouts, one
+__INSTFMT row per format) and include/la-instructions.def (one __INSTPAT_NAME
+row per instruction). Both are X-macro lists consumed by la-disassembler.h and
+are checked in, so building the library does not need Python.
+
+The description is line based; '#' starts a comment.
+
+    format <name> <branch> <operand>...
+
+defines an operand layout. <branch> is one of '-', cond, jump, call, indirect.
+Each operand is <kind>[<hi>:<lo>] with an optional second field
+[<hi>:<lo>|<hi>:<lo>] (the first field supplies the high bits), then optional
+<<shift and +add, then '!' if the instruction writes the register or '*' if it
+reads and writes it. Kinds are the token types: rd rj rk base fr vr xr fcc
+fcsr (registers), u32 s32 (immediates), pc (PC-relative offset) and off
+(offset from the preceding base register).
+
+    <mnemonic> <format> <LA32R|LA32|LA64> <match>
+
+defines an instruction: its fixed bits are <match> (hex), every bit not
+covered by an operand field of <format> is fixed. LA32R marks the LA32
+Reduced subset, LA32 encodings the rest of LA32 has, and LA64 encodings that
+do not exist on LA32. Order matters only where patterns overlap: the first
+match wins, and a later pattern may only generalize an earlier one.
+"""
+
+import re
+import sys
+
+KINDS = {
+    'rd': 'RD', 'rj': 'RJ', 'rk': 'RK', 'base': 'BASEREG',
+    'fr': 'FREG', 'vr': 'VREG', 'xr': 'XREG', 'fcc': 'FCC', 'fcsr': 'FCSR',
+    'u32': 'UIMM32', 's32': 'SIMM32', 'pc': 'PCOFF', 'off': 'ADDROFF',
+}
+REGISTERS = {'rd', 'rj', 'rk', 'base', 'fr', 'vr', 'xr', 'fcc', 'fcsr'}
+BRANCHES = {'-': 'NONE', 'cond': 'CONDITIONAL', 'jump': 'JUMP', 'call': 'CALL', 'indirect': 'INDIRECT'}
+MAX_OPERANDS = 4
+MAX_READS = 3
+MAX_WRITES = 2
+
+OPERAND = re.compile(r'^(\w+)\[(\d+):(\d+)(?:\|(\d+):(\d+))?\](?:<<(\d+))?(?:\+(\d+))?([!*]?)$')
+
+
+class Error(Exception):
+    pass
+
+
+def parse_operand(text):
+    m = OPERAND.match(text)
+    if not m or m.group(1) not in KINDS:
+        raise Error('bad operand %r' % text)
+    kind = m.group(1)
+    fields = [(int(m.group(2)), int(m.group(3)))]
+    if m.group(4):
+        fields.append((int(m.group(4)), int(m.group(5))))
+    for hi, lo in fields:
+        if hi < lo or hi > 31:
+            raise Error('bad field in %r' % text)
+    access = m.group(8)
+    if access and kind not in REGISTERS:
+        raise Error('%r: only registers are read or written' % text)
+    if kind in REGISTERS:
+        access = {'': 'READ', '!': 'WRITE', '*': 'READWRITE'}[access]
+    else:
+        access = 'NONE'
+    return {
+        'kind': kind,
+        'fields': fields,
+        'shift': int(m.group(6) or 0),
+        'add': int(m.group(7) or 0),
+        'access': access,
+    }
+
+
+def operand_mask(op):
+    mask = 0
+    for hi, lo in op['fields']:
+        mask |= ((1 << (hi - lo + 1)) - 1) << lo
+    return mask
+
+
+def parse(path):
+    formats = {}
+    order = []
+    insts = []
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            words = line.split('#', 1)[0].split()
+            if not words:
+                continue
+            try:
+                if words[0] == 'format':
+                    if len(words) < 3 or words[2] not in BRANCHES:
+                        raise Error('expected: format <name> <branch> <operand>...')
+                    name = words[1]
+                    if name in formats:
+                        raise Error('format %s defined twice' % name)
+                    ops = [parse_operand(w) for w in words[3:]]
+                    if len(ops) > MAX_OPERANDS:
+                        raise Error('more than %d operands' % MAX_OPERANDS)
+                    mask = 0
+                    for op in ops:
+                        if mask & operand_mask(op):
+                            raise Error('operand fields overlap')
+                        mask |= operand_mask(op)
+                    reads = sum(op['access'] in ('READ', 'READWRITE') for op in ops)
+                    writes = sum(op['access'] in ('WRITE', 'READWRITE') for op in ops)
+                    if reads > MAX_READS or writes > MAX_WRITES:
+                        raise Error('too many register reads or writes')
+                    formats[name] = {'name': name, 'branch': BRANCHES[words[2]], 'operands': ops, 'mask': mask, 'used': False}
+                    order.append(name)
+                else:
+                    if len(words) != 4:
+                        raise Error('expected: <mnemonic> <format> <LA32R|LA32|LA64> <match>')
+                    name, fmt, isa, match = words
+                    if fmt not in formats:
+                        raise Error('unknown format %s' % fmt)
+                    if isa not in ('LA32R', 'LA32', 'LA64'):
+                        raise Error('availability must be LA32R, LA32 or LA64')
+                    if not re.match(r'^[a-z][a-z0-9_.]*$', name):
+                        raise Error('bad mnemonic %s' % name)
+                    bits = int(match, 16)
+                    if bits >> 32 or bits & formats[fmt]['mask']:
+                        raise Error('match %s sets operand bits of format %s' % (match, fmt))
+                    formats[fmt]['used'] = True
+                    insts.append({'name': name, 'format': fmt, 'isa': isa, 'bits': bits,
+                                  'mask': 0xffffffff & ~formats[fmt]['mask'], 'line': number})
+            except Error as e:
+                raise Error('%s:%d: %s' % (path, number, e))
+    return [formats[n] for n in order], insts
+
+
+def check(formats, insts):
+    ids = {}
+    for inst in insts:
+        ident = inst['name'].upper().replace('.', '_')
+        if ident in ids:
+            raise Error('line %d: %s duplicates line %d' % (inst['line'], inst['name'], ids[ident]))
+        ids[ident] = inst['line']
+        inst['id'] = ident
+    for j, b in enumerate(insts):
+        for a in insts[:j]:
+            if (a['bits'] ^ b['bits']) & a['mask'] & b['mask']:
+                continue
+            # An earlier pattern may carve a special case out of a later, more
+            # general one (csrrd before csrxchg); anything else is ambiguous.
+            if (b['mask'] & ~a['mask']) != 0 or a['mask'] == b['mask']:
+                raise Error('line %d: %s overlaps %s on line %d' % (b['line'], b['name'], a['name'], a['line']))
+    for f in formats:
+        if not f['used']:
+            raise Error('format %s is not used' % f['name'])
+
+
+def pattern_string(inst, fmt):
+    # Bits high to low, with a space wherever an operand field starts or ends.
+    cuts = set()
+    for op in fmt['operands']:
+        for hi, lo in op['fields']:
+            cuts.add(hi + 1)
+            cuts.add(lo)
+    out = []
+    for b in range(31, -1, -1):
+        if b + 1 in cuts and b != 31:
+            out.append(' ')
+        out.append('?' if not inst['mask'] >> b & 1 else str(inst['bits'] >> b & 1))
+    return ''.join(out)
+
+
+def operand_macro(op):
+    (hi, lo) = op['fields'][0]
+    lo2, width2 = 0, 0
+    if len(op['fields']) > 1:
+        lo2 = op['fields'][1][1]
+        width2 = op['fields'][1][0] - lo2 + 1
+    return '__OPERAND(%s, %d, %d, %d, %d, %d, %d, %s)' % (
+        KINDS[op['kind']], lo, hi - lo + 1, lo2, width2, op['shift'], op['add'], op['access'])
+
+
+HEADER = '''// Generated by tools/la-isagen.py from isa/loongarch.isa; do not edit.
+//
+%s
+// No include guard: this file is meant to be included more than once.
+'''
+
+
+def write_formats(path, formats):
+    rows = []
+    for f in formats:
+        ops = [operand_macro(op) for op in f['operands']]
+        ops += ['__OPERAND_NONE'] * (MAX_OPERANDS - len(ops))
+        rows.append('__INSTFMT(%s, %s, %d, %s)' % (f['name'], f['branch'], len(f['operands']), ', '.join(ops)))
+    with open(path, 'w') as out:
+        out.write(HEADER % '''// Operand layouts, consumed as an X-macro:
+//     __INSTFMT(name, branch, count, op0, op1, op2, op3)
+// with each operand __OPERAND(type, lo, width, lo2, width2, shift, add, access)
+// or __OPERAND_NONE. An operand's value is its field at [lo, lo + width),
+// followed by the field at [lo2, lo2 + width2) if width2 is not zero, sign-extended
+// for SIMM32, PCOFF and ADDROFF, then shifted left by shift and offset by add.''')
+        out.write('\n')
+        out.write('\n'.join(rows))
+        out.write('\n')
+
+
+def write_instructions(path, formats, insts):
+    byname = {f['name']: f for f in formats}
+    rows = []
+    width = max(len(i['id']) for i in insts) + 1
+    for inst in insts:
+        rows.append('__INSTPAT_NAME(%-*s "%s", %s, %s, %s)' % (
+            width, inst['id'] + ',', pattern_string(inst, byname[inst['format']]),
+            inst['format'], inst['name'], inst['isa']))
+    with open(path, 'w') as out:
+        out.write(HEADER % '''// Instruction table, consumed as an X-macro:
+//     __INSTPAT_NAME(ID, pattern, format, name, isa)
+// ID names the Disassembler::Opcode, pattern is a BitPat string, format names the
+// operand layout in la-formats.def, name is the mnemonic and isa is the first
+// level that has the instruction: LA32R (LA32 Reduced), LA32 or LA64. The first
+// matching pattern wins, and opcode IDs follow table order.''')
+        out.write('\n')
+        out.write('\n'.join(rows))
+        out.write('\n')
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write('usage: %s <isa file> <output dir>\n' % argv[0])
+        return 2
+    try:
+        formats, insts = parse(argv[1])
+        check(formats, insts)
+    except (Error, OSError) as e:
+        sys.stderr.write('la-isagen: %s\n' % e)
+        return 1
+    write_formats(argv[2].rstrip('/') + '/la-formats.def', formats)
+    write_instructions(argv[2].rstrip('/') + '/la-instructions.def', formats, insts)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,508 @@
+#include "la-cfg.h"
+#include "la-disassembler.h"
+#include "la-elf.h"
+#include "la-export.h"
+#include "la-parallel.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// Streaming objdump-style disassembler for LoongArch code.
+//
+// Input is a LoongArch ELF file, raw little-endian instruction words, or a hex
+// dump of whitespace-separated words (optionally 0x-prefixed), from a file or
+// stdin, or a token stream written by --tokens. Input is read in large blocks and
+// output goes through one large buffer, so memory stays bounded regardless of
+// input size.
+
+using namespace LADisassembler;
+
+namespace {
+
+const std::size_t READ_BLOCK = 1 << 20;   // bytes per read()
+const std::size_t OUTPUT_BLOCK = 1 << 20; // bytes buffered before write()
+
+enum InputFormat {
+    FORMAT_AUTO,
+    FORMAT_ELF,
+    FORMAT_RAW,
+    FORMAT_HEX,
+    FORMAT_TOKENS,
+};
+
+struct Options {
+    InputFormat format = FORMAT_AUTO;
+    uint64_t base = 0;
+    bool addresses = true;
+    bool labels = false;
+    bool stats = false;
+    unsigned int threads = 1;
+    const char *path = "-";
+    std::string tokens;  // token stream output, if any
+};
+
+// Buffers the listing for stdout. A short write is remembered, not retried:
+// close() reports it, along with any error stdio saw on stdout.
+class Output {
+private:
+    std::vector<char> buf;
+    std::size_t used = 0;
+    bool failed = false;
+
+    void put(const char *data, std::size_t n) {
+        if (!failed && std::fwrite(data, 1, n, stdout) != n) {
+            failed = true;
+        }
+    }
+
+public:
+    Output() : buf(OUTPUT_BLOCK) {}
+
+    ~Output() {
+        flush();
+    }
+
+    void write(const char *data, std::size_t n) {
+        if (used + n > buf.size()) {
+            flush();
+            if (n > buf.size()) {
+                put(data, n);
+                return;
+            }
+        }
+        std::memcpy(buf.data() + used, data, n);
+        used += n;
+    }
+
+    void write(const char *s) {
+        write(s, std::strlen(s));
+    }
+
+    void flush() {
+        if (used) {
+            put(buf.data(), used);
+            used = 0;
+        }
+    }
+
+    // Writes out everything buffered. False, after saying so on stderr, if any of
+    // the listing did not reach stdout.
+    bool close() {
+        flush();
+        if (std::fflush(stdout) != 0 || std::ferror(stdout)) {
+            failed = true;
+        }
+        if (failed) {
+            std::fprintf(stderr, "la-objdump: error writing output\n");
+        }
+        return !failed;
+    }
+};
+
+void usage(FILE *f) {
+    std::fputs(
+        "usage: la-objdump [options] [file|-]\n"
+        "  -f, --format=FMT   input format: auto (default), elf, raw, hex, tokens\n"
+        "  -b, --base=ADDR    address of the first word for raw and hex input (default 0)\n"
+        "  -x, --hex-imm      print immediates in hex\n"
+        "  -a, --reg-alias    print ABI register names (a0, sp, ...)\n"
+        "  -p, --reg-prefix   prefix register names with '$'\n"
+        "  -3, --la32         decode with the LA32 table (LA64-only words are invalid)\n"
+        "                     and print 32-bit addresses\n"
+        "  -R, --la32r        decode with the LA32 Reduced table, for LA32R cores\n"
+        "                     (implies -3)\n"
+        "  -n, --no-addresses print instruction text only\n"
+        "  -L, --labels       print an L_<addr>: label before each branch and call target\n"
+        "                     (raw and hex input are read in full first)\n"
+        "  -T, --tokens=FILE  write a binary token stream to FILE instead of a listing\n"
+        "                     (not with -L)\n"
+        "  -j, --threads=N    worker threads (default 1, 0 = all)\n"
+        "  -s, --stats        print decoder statistics to stderr when done (needs a\n"
+        "                     build with LADISASSEMBLER_STATS, e.g. make STATS=1)\n"
+        "  -h, --help         show this help\n", f);
+}
+
+// Disassembles blocks of words read from a stream, keeping the PC across blocks.
+// Streamed blocks all go through one ParallelDisassembler, so its worker pool is
+// started once for the whole input. With labels the whole input is kept until
+// finish(), since any word may be the target of a later branch. With a token
+// stream the words go there instead.
+class StreamDisassembler {
+private:
+    const Disassembler &disassembler;
+    ParallelDisassembler::Options options;
+    ParallelDisassembler parallel;
+    Output &out;
+    uint64_t base;
+    uint64_t pc;
+    bool labels;
+    TokenStreamWriter *tokens;
+    std::vector<uint32_t> image;
+
+    void print(ParallelDisassembler &p, const uint32_t *words, std::size_t n, uint64_t at) {
+        p.run(words, n, at, [this](const char *text, std::size_t length) { out.write(text, length); });
+    }
+
+public:
+    StreamDisassembler(const Disassembler &d, const ParallelDisassembler::Options &o, Output &out, uint64_t base, bool labels,
+            TokenStreamWriter *tokens)
+        : disassembler(d), options(o), parallel(d, o), out(out), base(base), pc(base), labels(labels), tokens(tokens) {}
+
+    bool words(const uint32_t *words, std::size_t n) {
+        if (tokens) {
+            if (!tokens->write(words, n, pc)) {
+                return false;
+            }
+        } else if (labels) {
+            image.insert(image.end(), words, words + n);
+        } else {
+            print(parallel, words, n, pc);
+        }
+        pc += 4 * (uint64_t)n;
+        return true;
+    }
+
+    bool finish() {
+        if (tokens) {
+            return tokens->close();
+        }
+        if (labels) {
+            ControlFlowGraph::Options o;
+            o.threads = options.threads;
+            ControlFlowGraph cfg(disassembler, image.data(), image.size(), base, disassembler.options(), o);
+            ParallelDisassembler::Options withLabels = options;
+            withLabels.labels = &cfg;
+            ParallelDisassembler p(disassembler, withLabels);
+            print(p, image.data(), image.size(), base);
+        }
+        return true;
+    }
+};
+
+bool read_raw(FILE *in, const uint8_t *head, std::size_t headLength, StreamDisassembler &sd) {
+    std::vector<uint32_t> words(READ_BLOCK / 4);
+    std::size_t have = headLength;
+    std::memcpy(words.data(), head, headLength);
+    while (true) {
+        std::size_t got = std::fread((uint8_t *)words.data() + have, 1, READ_BLOCK - have, in);
+        have += got;
+        std::size_t whole = have / 4;
+        if (whole && (have == READ_BLOCK || got == 0)) {
+            if (!sd.words(words.data(), whole)) {
+                return false;
+            }
+            std::size_t rest = have - whole * 4;
+            std::memmove(words.data(), (uint8_t *)words.data() + whole * 4, rest);
+            have = rest;
+        }
+        if (got == 0) {
+            break;
+        }
+    }
+    if (have != 0) {
+        std::fprintf(stderr, "la-objdump: ignoring %zu trailing byte(s)\n", have);
+    }
+    return !std::ferror(in);
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool read_hex(FILE *in, const uint8_t *head, std::size_t headLength, StreamDisassembler &sd) {
+    std::vector<char> text(READ_BLOCK);
+    std::vector<uint32_t> words;
+    words.reserve(READ_BLOCK / 4);
+    std::string token;
+    std::size_t have = headLength;
+    std::memcpy(text.data(), head, headLength);
+    bool ok = true;
+
+    auto finish_token = [&]() {
+        if (token.empty()) {
+            return;
+        }
+        std::size_t i = (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) ? 2 : 0;
+        uint64_t value = 0;
+        bool valid = token.size() - i <= 8;
+        for (; valid && i < token.size(); i++) {
+            int v = hex_value(token[i]);
+            valid = v >= 0;
+            value = value << 4 | v;
+        }
+        if (!valid) {
+            std::fprintf(stderr, "la-objdump: invalid hex word '%s'\n", token.c_str());
+            ok = false;
+        } else {
+            words.push_back(value);
+        }
+        token.clear();
+    };
+
+    while (ok) {
+        std::size_t got = std::fread(text.data() + have, 1, text.size() - have, in);
+        have += got;
+        for (std::size_t i = 0; i < have && ok; i++) {
+            if (is_space(text[i])) {
+                finish_token();
+            } else {
+                token.push_back(text[i]);
+            }
+        }
+        have = 0;
+        if (got == 0) {
+            finish_token();
+        }
+        if (words.size() >= READ_BLOCK / 4 || (got == 0 && !words.empty())) {
+            ok = sd.words(words.data(), words.size());
+            words.clear();
+        }
+        if (got == 0) {
+            break;
+        }
+    }
+    return ok && !std::ferror(in);
+}
+
+int dump_elf(Disassembler &disassembler, const Options &options, Output &out) {
+    ElfImage image;
+    if (!image.open(options.path)) {
+        return 1;
+    }
+    if (!image.elf64()) {
+        disassembler.set_mode32(true);
+    }
+    disassembler.set_symbol_resolver(&image.symbols());
+
+    if (!options.tokens.empty()) {
+        TokenStreamWriter writer(disassembler);
+        bool ok = writer.open(options.tokens.c_str());
+        for (const ElfImage::Section &section : image.sections()) {
+            ok = ok && writer.write(section.words, section.count, section.addr);
+        }
+        return writer.close() && ok ? 0 : 1;
+    }
+
+    // One ParallelDisassembler for every section; labels point at cfg, which is
+    // rebuilt for each section before it is listed.
+    ControlFlowGraph cfg;
+    ParallelDisassembler::Options parallel;
+    parallel.threads = options.threads;
+    parallel.addresses = options.addresses;
+    parallel.labels = options.labels ? &cfg : nullptr;
+    parallel.symbols = &image.symbols();
+    ParallelDisassembler listing(disassembler, parallel);
+    for (const ElfImage::Section &section : image.sections()) {
+        out.write("\nDisassembly of section ");
+        out.write(section.name);
+        out.write(":\n");
+        if (options.labels) {
+            ControlFlowGraph::Options o;
+            o.threads = options.threads;
+            cfg.build(disassembler, section.words, section.count, section.addr, disassembler.options(), o);
+        }
+        listing.run(section.words, section.count, section.addr,
+            [&out](const char *text, std::size_t length) { out.write(text, length); });
+    }
+    return 0;
+}
+
+// Prints a listing from the records of a token stream, without decoding. Text
+// options apply as usual; mode32 and instruction aliases are as when it was written.
+int dump_tokens(Disassembler &disassembler, const Options &options, Output &out) {
+    TokenStreamReader reader;
+    if (!reader.open(options.path)) {
+        return 1;
+    }
+    disassembler.set_mode32(reader.flags() & TOKEN_STREAM_MODE32);
+    disassembler.set_reduced(reader.flags() & TOKEN_STREAM_REDUCED);
+    Disassembler::DecodeTokenArray tokens;
+    for (const TokenRecord &r : reader) {
+        if (options.addresses) {
+            char head[40];
+            TextWriter w(head, sizeof(head));
+            w.put_hex(r.pc, 8);
+            w.put(":  ", 3);
+            w.put_hex(r.word, 8);
+            w.put("  ", 2);
+            out.write(head, w.finish());
+        }
+        if (reader.tokens(r, tokens)) {
+            char text[128];
+            std::size_t length = disassembler.fmt_tokens_to(text, sizeof(text), r.pc, tokens);
+            if (length < sizeof(text)) {
+                out.write(text, length);
+            } else {
+                out.write(disassembler.fmt_tokens(r.pc, tokens).c_str());
+            }
+        }
+        out.write("\n", 1);
+    }
+    return 0;
+}
+
+// Called after Output::close(), so the listing is out before the statistics.
+void print_stats(const Options &options) {
+    if (options.stats) {
+        Disassembler::dump_stats(std::cerr, Disassembler::stats());
+    }
+}
+
+bool parse_number(const char *s, uint64_t &value) {
+    char *end = nullptr;
+    value = std::strtoull(s, &end, 0);
+    return end != s && *end == '\0';
+}
+
+}
+
+int main(int argc, char **argv) {
+    Disassembler disassembler;
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        std::size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") == 0 && eq != std::string::npos) {
+            value = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        }
+        auto need_value = [&]() -> bool {
+            if (!value.empty()) {
+                return true;
+            }
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "la-objdump: %s needs a value\n", arg.c_str());
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            usage(stdout);
+            return 0;
+        } else if (arg == "-x" || arg == "--hex-imm") {
+            disassembler.set_imm_hex(true);
+        } else if (arg == "-a" || arg == "--reg-alias") {
+            disassembler.set_reg_alias(true);
+        } else if (arg == "-p" || arg == "--reg-prefix") {
+            disassembler.set_reg_prefix(true);
+        } else if (arg == "-3" || arg == "--la32") {
+            disassembler.set_mode32(true);
+        } else if (arg == "-R" || arg == "--la32r") {
+            disassembler.set_mode32(true);
+            disassembler.set_reduced(true);
+        } else if (arg == "-n" || arg == "--no-addresses") {
+            options.addresses = false;
+        } else if (arg == "-L" || arg == "--labels") {
+            options.labels = true;
+        } else if (arg == "-s" || arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "-f" || arg == "--format") {
+            if (!need_value()) return 2;
+            if (value == "auto") options.format = FORMAT_AUTO;
+            else if (value == "elf") options.format = FORMAT_ELF;
+            else if (value == "raw") options.format = FORMAT_RAW;
+            else if (value == "hex") options.format = FORMAT_HEX;
+            else if (value == "tokens") options.format = FORMAT_TOKENS;
+            else {
+                std::fprintf(stderr, "la-objdump: unknown format '%s'\n", value.c_str());
+                return 2;
+            }
+        } else if (arg == "-b" || arg == "--base") {
+            if (!need_value() || !parse_number(value.c_str(), options.base)) {
+                std::fprintf(stderr, "la-objdump: invalid base address\n");
+                return 2;
+            }
+        } else if (arg == "-T" || arg == "--tokens") {
+            if (!need_value()) return 2;
+            options.tokens = value;
+        } else if (arg == "-j" || arg == "--threads") {
+            uint64_t threads;
+            if (!need_value() || !parse_number(value.c_str(), threads)) {
+                std::fprintf(stderr, "la-objdump: invalid thread count\n");
+                return 2;
+            }
+            options.threads = threads;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::fprintf(stderr, "la-objdump: unknown option '%s'\n", arg.c_str());
+            usage(stderr);
+            return 2;
+        } else {
+            options.path = argv[i];
+        }
+    }
+
+    if (options.labels && !options.tokens.empty()) {
+        std::fprintf(stderr, "la-objdump: --labels applies to listings, not to --tokens\n");
+        return 2;
+    }
+
+    bool fromStdin = std::strcmp(options.path, "-") == 0;
+    FILE *in = fromStdin ? stdin : std::fopen(options.path, "rb");
+    if (!in) {
+        std::fprintf(stderr, "la-objdump: cannot open %s\n", options.path);
+        return 1;
+    }
+
+    // Sniff the first bytes to pick a format; they are handed on to the reader.
+    uint8_t head[64];
+    std::size_t headLength = std::fread(head, 1, sizeof(head), in);
+    InputFormat format = options.format;
+    if (format == FORMAT_AUTO) {
+        if (headLength >= 4 && std::memcmp(head, ELFMAG, SELFMAG) == 0) {
+            format = FORMAT_ELF;
+        } else if (headLength >= sizeof(TOKEN_STREAM_MAGIC) && std::memcmp(head, TOKEN_STREAM_MAGIC, sizeof(TOKEN_STREAM_MAGIC)) == 0) {
+            format = FORMAT_TOKENS;
+        } else {
+            format = FORMAT_HEX;
+            for (std::size_t i = 0; i < headLength; i++) {
+                if (hex_value(head[i]) < 0 && !is_space(head[i]) && head[i] != 'x' && head[i] != 'X') {
+                    format = FORMAT_RAW;
+                    break;
+                }
+            }
+        }
+    }
+
+    Output out;
+    if (format == FORMAT_ELF || format == FORMAT_TOKENS) {
+        if (fromStdin) {
+            std::fprintf(stderr, "la-objdump: %s input must be a file\n", format == FORMAT_ELF ? "ELF" : "token stream");
+            return 1;
+        }
+        std::fclose(in);
+        int status = format == FORMAT_ELF ? dump_elf(disassembler, options, out) : dump_tokens(disassembler, options, out);
+        if (!out.close() && status == 0) {
+            status = 1;
+        }
+        print_stats(options);
+        return status;
+    }
+
+    TokenStreamWriter writer(disassembler);
+    if (!options.tokens.empty() && !writer.open(options.tokens.c_str())) {
+        return 1;
+    }
+    ParallelDisassembler::Options parallel;
+    parallel.threads = options.threads;
+    parallel.addresses = options.addresses;
+    StreamDisassembler sd(disassembler, parallel, out, options.base, options.labels, options.tokens.empty() ? nullptr : &writer);
+    bool ok = format == FORMAT_RAW ? read_raw(in, head, headLength, sd) : read_hex(in, head, headLength, sd);
+    ok = ok && sd.finish();
+    if (!fromStdin) {
+        std::fclose(in);
+    }
+    ok = out.close() && ok;
+    print_stats(options);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,309 @@
+#include "la-disassembler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <time.h>
+
+// Exhaustive sweep of the 32-bit encoding space through the decoder.
+//
+// Every word (or every word under a fixed prefix of high bits) is classified by
+// the decode tree (Decoder::decode_index) and by the batch path
+// (Decoder::decode_batch, vectorized where the CPU allows), and a sample of the
+// words by the reference linear scan (Decoder::decode_index_linear). The report
+// lists throughput per core, encodings on which the engines disagree, overlapping
+// pattern pairs, patterns that win fewer encodings than they describe (shadowed
+// by an earlier pattern), and a per-mnemonic coverage histogram.
+
+using namespace LADisassembler;
+
+namespace {
+
+typedef std::decay_t<decltype(Disassembler::decoder())> Table;
+
+const uint64_t CHUNK_WORDS = 1 << 16;  // words per work item
+const std::size_t MAX_EXAMPLES = 16;    // disagreements kept for the report
+
+struct Options {
+    unsigned int threads = 0;
+    Disassembler::IsaLevel level = Disassembler::LA64;
+    uint32_t prefix = 0;
+    unsigned int prefixBits = 0;
+    uint64_t linearEvery = 256;
+    bool histogram = true;
+};
+
+struct Disagreement {
+    uint32_t word;
+    int tree;
+    int batch;
+    int linear;  // -2 if the word was not checked against the linear scan
+};
+
+// Per-thread results, merged after the sweep.
+struct Tally {
+    std::vector<uint64_t> hits;  // per pattern index
+    uint64_t misses = 0;
+    uint64_t words = 0;
+    uint64_t linearChecked = 0;
+    uint64_t disagreements = 0;
+    std::vector<Disagreement> examples;
+    double seconds = 0;  // CPU time of the worker thread
+};
+
+void usage(FILE *f) {
+    std::fputs(
+        "usage: la-sweep [options]\n"
+        "  -j, --threads=N      worker threads (default 0 = one per hardware thread)\n"
+        "  -3, --la32           sweep the LA32 table\n"
+        "  -R, --la32r          sweep the LA32 Reduced table\n"
+        "  -P, --prefix=V/BITS  sweep only words whose top BITS bits equal V (default 0/0:\n"
+        "                       all 2^32 words)\n"
+        "  -l, --linear=N       check a hashed sample of 1 in N words against the linear\n"
+        "                       scan (default 256, 1 = every word, 0 = never)\n"
+        "  -q, --no-histogram   omit the per-mnemonic histogram\n"
+        "  -h, --help           show this help\n", f);
+}
+
+const char *name_of(const Table &table, int index) {
+    return index < 0 ? "(none)" : table.entry(index)->name;
+}
+
+double thread_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void sweep(const Table &table, const Options &options, uint64_t base, uint64_t chunks,
+        std::atomic<uint64_t> &next, Tally &tally) {
+    std::vector<uint32_t> words(CHUNK_WORDS);
+    std::vector<int32_t> batch(CHUNK_WORDS);
+    tally.hits.assign(table.count(), 0);
+    double start = thread_seconds();
+
+    for (uint64_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+        uint32_t first = base + c * CHUNK_WORDS;
+        for (uint64_t i = 0; i < CHUNK_WORDS; i++) {
+            words[i] = first + i;
+        }
+        table.decode_batch(words.data(), CHUNK_WORDS, batch.data());
+
+        for (uint64_t i = 0; i < CHUNK_WORDS; i++) {
+            uint32_t w = words[i];
+            int tree = table.decode_index(w);
+            int linear = -2;
+            // Sample on the high bits of a multiplicative hash, which depend on
+            // every bit of w, so sampled words cover all register fields.
+            if (options.linearEvery && ((uint64_t)(uint32_t)(w * 0x9e3779b1U) * options.linearEvery >> 32) == 0) {
+                linear = table.decode_index_linear(w);
+                tally.linearChecked++;
+            }
+            if (tree != batch[i] || (linear != -2 && linear != tree)) {
+                tally.disagreements++;
+                if (tally.examples.size() < MAX_EXAMPLES) {
+                    tally.examples.push_back({w, tree, batch[i], linear});
+                }
+            }
+            if (tree < 0) {
+                tally.misses++;
+            } else {
+                tally.hits[tree]++;
+            }
+        }
+        tally.words += CHUNK_WORDS;
+    }
+    tally.seconds = thread_seconds() - start;
+}
+
+// Number of words under the swept prefix that pattern p matches, ignoring every
+// other pattern.
+uint64_t expected_count(const BitPat &p, const Options &options) {
+    uint32_t high = options.prefixBits ? ~0U << (32 - options.prefixBits) : 0;
+    if (((uint32_t)p.get_bits() ^ options.prefix) & (uint32_t)p.get_mask() & high) {
+        return 0;
+    }
+    return 1ULL << __builtin_popcount(~(uint32_t)p.get_mask() & ~high);
+}
+
+bool parse_number(const char *s, uint64_t &value) {
+    char *end = nullptr;
+    value = std::strtoull(s, &end, 0);
+    return end != s && *end == '\0';
+}
+
+bool parse_prefix(const std::string &s, Options &options) {
+    std::size_t slash = s.find('/');
+    uint64_t value, bits;
+    if (slash == std::string::npos || !parse_number(s.substr(0, slash).c_str(), value) ||
+            !parse_number(s.substr(slash + 1).c_str(), bits) || bits > 32 - 16 || (bits < 64 && value >> bits)) {
+        return false;
+    }
+    options.prefixBits = bits;
+    options.prefix = bits ? (uint32_t)value << (32 - bits) : 0;
+    return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        std::size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") == 0 && eq != std::string::npos) {
+            value = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        }
+        auto need_value = [&]() -> bool {
+            if (!value.empty()) {
+                return true;
+            }
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "la-sweep: %s needs a value\n", arg.c_str());
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            usage(stdout);
+            return 0;
+        } else if (arg == "-3" || arg == "--la32") {
+            options.level = Disassembler::LA32;
+        } else if (arg == "-R" || arg == "--la32r") {
+            options.level = Disassembler::LA32R;
+        } else if (arg == "-q" || arg == "--no-histogram") {
+            options.histogram = false;
+        } else if (arg == "-j" || arg == "--threads") {
+            uint64_t threads;
+            if (!need_value() || !parse_number(value.c_str(), threads)) {
+                std::fprintf(stderr, "la-sweep: invalid thread count\n");
+                return 2;
+            }
+            options.threads = threads;
+        } else if (arg == "-l" || arg == "--linear") {
+            if (!need_value() || !parse_number(value.c_str(), options.linearEvery)) {
+                std::fprintf(stderr, "la-sweep: invalid linear sampling interval\n");
+                return 2;
+            }
+        } else if (arg == "-P" || arg == "--prefix") {
+            if (!need_value() || !parse_prefix(value, options)) {
+                std::fprintf(stderr, "la-sweep: invalid prefix, expected VALUE/BITS with BITS <= 16\n");
+                return 2;
+            }
+        } else {
+            std::fprintf(stderr, "la-sweep: unknown argument '%s'\n", arg.c_str());
+            usage(stderr);
+            return 2;
+        }
+    }
+    if (options.threads == 0) {
+        options.threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    const Table &table = Disassembler::decoder(options.level);
+    const uint64_t total = 1ULL << (32 - options.prefixBits);
+    const uint64_t chunks = total / CHUNK_WORDS;
+
+    std::printf("table: %s, %u patterns, %zu bytes, depth %u\n",
+        options.level == Disassembler::LA32R ? "la32r" : options.level == Disassembler::LA32 ? "la32" : "la64",
+        table.count(), table.table_bytes(), table.tree_depth());
+    std::printf("sweep: %llu words from 0x%08x, %u thread(s), linear scan on 1 in %llu\n",
+        (unsigned long long)total, options.prefix, options.threads, (unsigned long long)options.linearEvery);
+    std::fflush(stdout);
+
+    std::vector<Tally> tallies(options.threads);
+    std::atomic<uint64_t> next(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned int t = 0; t < options.threads; t++) {
+        pool.emplace_back(sweep, std::cref(table), std::cref(options), (uint64_t)options.prefix, chunks,
+            std::ref(next), std::ref(tallies[t]));
+    }
+    for (std::thread &t : pool) {
+        t.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Tally sum;
+    sum.hits.assign(table.count(), 0);
+    double busy = 0;
+    for (const Tally &t : tallies) {
+        for (unsigned int p = 0; p < table.count(); p++) {
+            sum.hits[p] += t.hits[p];
+        }
+        sum.misses += t.misses;
+        sum.words += t.words;
+        sum.linearChecked += t.linearChecked;
+        sum.disagreements += t.disagreements;
+        for (const Disagreement &d : t.examples) {
+            if (sum.examples.size() < MAX_EXAMPLES) {
+                sum.examples.push_back(d);
+            }
+        }
+        busy += t.seconds;
+    }
+
+    std::printf("\nthroughput: %.3f s wall, %.1f M words/s total, %.1f M words/s per core\n",
+        wall, sum.words / wall / 1e6, sum.words / busy / 1e6);
+    for (unsigned int t = 0; t < options.threads; t++) {
+        std::printf("  thread %u: %llu words in %.3f s CPU\n", t, (unsigned long long)tallies[t].words, tallies[t].seconds);
+    }
+    std::printf("decoded: %llu (%.4f%%), invalid: %llu\n", (unsigned long long)(sum.words - sum.misses),
+        100.0 * (sum.words - sum.misses) / sum.words, (unsigned long long)sum.misses);
+
+    std::printf("\ndisagreements: %llu (tree vs batch on every word, vs linear on %llu)\n",
+        (unsigned long long)sum.disagreements, (unsigned long long)sum.linearChecked);
+    for (const Disagreement &d : sum.examples) {
+        std::printf("  %08x: tree %s, batch %s, linear %s\n", d.word, name_of(table, d.tree),
+            name_of(table, d.batch), d.linear == -2 ? "-" : name_of(table, d.linear));
+    }
+
+    unsigned int ambiguous = 0;
+    std::printf("\noverlapping patterns: %zu\n", table.overlaps().size());
+    for (const auto &pair : table.overlaps()) {
+        const BitPat &a = table.entry(pair.first)->pattern;
+        const BitPat &b = table.entry(pair.second)->pattern;
+        bool special = a.specializes(b);
+        ambiguous += !special;
+        std::printf("  %s %s %s\n", name_of(table, pair.first), special ? "specializes" : "AMBIGUOUS with",
+            name_of(table, pair.second));
+    }
+
+    unsigned int shadowed = 0;
+    std::printf("\nshadowed patterns (encodings won / described):\n");
+    for (unsigned int p = 0; p < table.count(); p++) {
+        uint64_t expected = expected_count(table.entry(p)->pattern, options);
+        if (sum.hits[p] != expected) {
+            shadowed++;
+            std::printf("  %-20s %llu / %llu%s\n", name_of(table, p), (unsigned long long)sum.hits[p],
+                (unsigned long long)expected, sum.hits[p] == 0 ? "  never decodes" : "");
+        }
+    }
+    std::printf("  %u pattern(s)\n", shadowed);
+
+    if (options.histogram) {
+        std::vector<unsigned int> order;
+        for (unsigned int p = 0; p < table.count(); p++) {
+            if (sum.hits[p]) {
+                order.push_back(p);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(),
+            [&](unsigned int a, unsigned int b) { return sum.hits[a] > sum.hits[b]; });
+        std::printf("\ncoverage (%zu of %u mnemonics reached):\n", order.size(), table.count());
+        for (unsigned int p : order) {
+            std::printf("  %-20s %12llu  %8.4f%%\n", name_of(table, p), (unsigned long long)sum.hits[p],
+                100.0 * sum.hits[p] / sum.words);
+        }
+    }
+
+    return sum.disagreements || ambiguous ? 1 : 0;
+}